@@ -2,14 +2,27 @@
  * $Id$
  */
 
+#include <string.h>
+
 #include <QDir>
 #include <QFileInfo>
+#include <QDateTime>
+#include <QImageReader>
+#include <QMutexLocker>
+#include <QCoreApplication>
 #include <QSplashScreen>
 #include <QPainter>
 #include <QResizeEvent>
+#include <QKeyEvent>
+#include <QThread>
+#include <QRunnable>
 
 #include "ps.hh"
 #include "logger.hh"
+#include "pixops.hh"
+#include "timing.hh"
+#include "trace.hh"
+#include "cache.hh"
 #include "album.hh"
 
 /*
@@ -33,37 +46,137 @@ const uint16_t tilt_factor    = 80 * IANGLE_MAX / 360;
 const uint16_t spacing_offset = 60;                     // space between each angled cover
 const uint32_t f_max          = 2 * 65536;
 
+/*
+ * Default byte budget for processed cover images (see CoverStore);
+ * a 130x175 cover plus reflection is ~150k.
+ */
+
+const uint32_t cover_cache_budget = 8 << 20;
+
+/*
+ * Default byte budget for rendered resting frames (an 800x400 one is
+ * ~1.3M), and how many covers either side of the focus to prerender
+ * them for while idle (RENDER_THREAD), as far as that budget goes.
+ */
+
+const uint32_t frame_cache_budget = 8 << 20;
+const int32_t  frame_prerender    = 2;
+const quint64  frame_none         = ~(quint64)0;
+
+/*
+ * How many covers either side of the initial focus have to be loaded
+ * before the browser is shown.
+ */
+
+const int32_t boot_covers = 3;
+
+/*
+ * Mip levels carried by each processed cover (fewer if they'd get
+ * narrower or shorter than mip_min_size).
+ */
+
+const uint8_t  mip_levels   = 4;
+const uint16_t mip_min_size = 8;
+
+/*
+ * Processed covers persist here (in the pics dir) between runs.
+ */
+
+const char *const cover_cache_file = ".covers";
+
+/*
+ * Strip rendering: how many strips to hand out per core (more strips
+ * than cores evens out the load, since the focused cover is much
+ * taller than the ones on the side), and the narrowest strip worth
+ * scheduling.
+ */
+
+const uint16_t strips_per_core = 4;
+const uint16_t strip_min_width = 16;
+
+/*
+ * drawn_t key of a column that's a copy of the one to its left
+ * (reduced quality, see renderStrip()).
+ */
+
+const qint64 drawn_copy = -1;
+
+/*
+ * One vertical strip of the browse view, raytraced on a pool thread.
+ */
+
+class StripRender : public QRunnable {
+
+ private:
+    AlbumBrowser *ab;
+    int16_t lb, rb;
+    QRect *dirty;
+
+ public:
+    StripRender(AlbumBrowser *ab_, int16_t lb_, int16_t rb_, QRect *dirty_) :
+        ab(ab_), lb(lb_), rb(rb_), dirty(dirty_) {}
+
+    void run(void) {
+        *dirty = ab->renderStrip(lb, rb);
+    }
+};
+
 /* ---------- */
 
 AlbumCover::AlbumCover(void) {
     angle = 0;
     cx = cy = 0;
+    mtime = size = 0;
 }
 
 AlbumCover::AlbumCover(const QImage &image_, const QString &path_) {
     angle = 0;
     cx = cy = 0;
+    mtime = size = 0;
     image = image_;
     path = path_;
 }
 
 AlbumCover::AlbumCover(const AlbumCover &a) {
-    image = a.image;
-    path  = a.path;
+    image  = a.image;
+    source = a.source;
+    path   = a.path;
+    mtime  = a.mtime;
+    size   = a.size;
     angle = a.angle;
     cx    = a.cx;
     cy    = a.cy;
 }
 
 const AlbumCover &AlbumCover::operator=(const AlbumCover &a) {
-    image = a.image;
-    path  = a.path;
+    image  = a.image;
+    source = a.source;
+    path   = a.path;
+    mtime  = a.mtime;
+    size   = a.size;
     angle = a.angle;
     cx    = a.cx;
     cy    = a.cy;
     return *this;
 }
 
+/*
+ * Decode (or take the in-memory source) and process the image.
+ */
+
+bool AlbumCover::load(uint16_t c_width, uint16_t c_height) {
+    if (!source.isNull()) {
+        image = source;
+    } else if (!image.load(path)) {
+        LOG.error("unable to load %s", (const char*)path.toAscii());
+        return false;
+    }
+
+    process(c_width, c_height);
+
+    return !image.isNull();
+}
+
 /*
  * Process the image: scale the image to the cover size, and calculate
  * its reflection.  Angle data should be set by collection owner.
@@ -77,48 +190,373 @@ const AlbumCover &AlbumCover::operator=(const AlbumCover &a) {
  */
 
 void AlbumCover::process(uint16_t c_width, uint16_t c_height) {
-    LOG.puke("process(%u, %u)", c_width, c_height);
+    PS_PUKE("process(%u, %u)", c_width, c_height);
+    TraceSpan t("process");
 
     image = image.scaled(c_width, c_height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    if (image.isNull())
+        return;
+
+    /*
+     * The reflection kernel works on raw pixels in the build's format
+     * (PIXEL_BITS).
+     */
+
+    if (image.format() != PIXEL_FORMAT)
+        image = image.convertToFormat(PIXEL_FORMAT);
 
     /*
      * Calculate the minumum size(height) of the reflection we want to
      * put into the image and allocate.
      */
 
-    uint16_t reflection_height = c_height*2/3;
-    uint16_t total_height      = c_height + 1 + reflection_height;
+    uint16_t total_height = rows(c_height);
+    uint8_t  n            = levels(c_width, c_height);
+
+    QImage out = allocate(c_width, total_height, n);
 
-    QImage out(c_width, total_height, QImage::Format_RGB32);
-    QPainter p(&out);
+    /*
+     * Copy, mirror and faux alpha blend the bottom vertically-flipped
+     * portion in one pass (see pixops.cc).
+     */
 
-    p.drawImage(0, 0, image);
-    p.translate(0, c_height+1);
-    p.drawImage(0, 0, image.mirrored(false, true), 0, 0, c_width, reflection_height);
+    const QImage &in = image;
 
-    p.end();
+    reflectCover((pixel_t*)out.bits(), out.bytesPerLine() / sizeof(pixel_t),
+                 (const pixel_t*)in.bits(), in.bytesPerLine() / sizeof(pixel_t),
+                 c_width, c_height, total_height);
 
     /*
-     * Faux alpha blend the bottom vertically-flipped portion.
+     * Then the smaller copies the raytracer uses for covers far away
+     * or at steep angles.
      */
 
-    uint16_t stop = out.size().height();
-    uint32_t *px;
-    uint8_t r, g, b, f;
+    buildMips((pixel_t*)out.bits(), c_width, total_height, stride(c_width), n);
+
+#if COLUMN_MAJOR
+    image = transposed(out, c_width, total_height, n);
+#else
+    image = out;
+#endif
+}
+
+/*
+ * A black processed cover, for placeholders.
+ */
+
+QImage AlbumCover::blank(uint16_t c_width, uint16_t c_height) {
+    uint16_t total_height = rows(c_height);
+    uint8_t  n            = levels(c_width, c_height);
+
+#if COLUMN_MAJOR
+    QImage image = allocate(total_height, c_width, n);
+#else
+    QImage image = allocate(c_width, total_height, n);
+#endif
+
+    image.fill(Qt::black);
+
+    return image;
+}
+
+/*
+ * Rows in a processed cover (the cover and its reflection), and how
+ * many mip levels it carries.
+ */
+
+uint16_t AlbumCover::rows(uint16_t c_height) {
+    return c_height + 1 + c_height*2/3;
+}
+
+uint8_t AlbumCover::levels(uint16_t c_width, uint16_t c_height) {
+    uint16_t total_height = rows(c_height);
+    uint8_t n = 0;
+
+    while (n < mip_levels &&
+           (c_width >> (n+1)) >= mip_min_size &&
+           (total_height >> (n+1)) >= mip_min_size)
+        n++;
+
+    return n;
+}
+
+/*
+ * Pixels per scanline of a w wide image: QImage pads lines to 32
+ * bits, which with 16-bit pixels and an odd w is one more than w.
+ */
+
+uint16_t AlbumCover::stride(uint16_t w) {
+    return ((w * sizeof(pixel_t) + 3) & ~3) / sizeof(pixel_t);
+}
+
+/*
+ * Scanlines in an image for a w x h base with n mip levels packed
+ * behind it (see pixops.hh), rounded up to whole lines, and such an
+ * image.
+ */
+
+uint16_t AlbumCover::lines(uint16_t w, uint16_t h, uint8_t n) {
+    uint32_t s     = stride(w);
+    uint32_t extra = mipOffset(w, h, s, n+1) - s*h;
+
+    return h + (extra + s - 1) / s;
+}
+
+QImage AlbumCover::allocate(uint16_t w, uint16_t h, uint8_t n) {
+    return QImage(w, lines(w, h, n), PIXEL_FORMAT);
+}
+
+/*
+ * Swap rows and columns of a w x h base and its n mip levels.  The
+ * bases' strides may differ; the levels behind them are packed.
+ */
+
+QImage AlbumCover::transposed(const QImage &in, uint16_t w, uint16_t h, uint8_t n) {
+    QImage out = allocate(h, w, n);
+
+    for (uint8_t l = 0; l <= n; l++) {
+        transposeBlocked((pixel_t*)out.bits() + mipOffset(h, w, stride(h), l),
+                         l ? h >> l : stride(h),
+                         (const pixel_t*)in.bits() + mipOffset(w, h, stride(w), l),
+                         l ? w >> l : stride(w),
+                         w >> l, h >> l);
+    }
+
+    return out;
+}
+
+/* ------------- */
+
+CoverStore::CoverStore(uint32_t budget_) {
+    setBudget(budget_ ? budget_ : cover_cache_budget);
+    c_width = c_height = 0;
+    resetStats();
+}
+
+void CoverStore::setBudget(uint32_t bytes) {
+    PS_DEBUG("cover cache budget: %u bytes", bytes);
+    cache.setMaxCost(bytes);
+}
+
+uint32_t CoverStore::budget(void) const {
+    return cache.maxCost();
+}
+
+uint32_t CoverStore::used(void) const {
+    return cache.totalCost();
+}
+
+uint32_t CoverStore::count(void) const {
+    return cache.count();
+}
+
+/*
+ * Everything cached was processed for the old size.
+ */
+
+void CoverStore::setCoverSize(uint16_t c_width_, uint16_t c_height_) {
+    if (c_width == c_width_ && c_height == c_height_)
+        return;
+
+    c_width  = c_width_;
+    c_height = c_height_;
+    clear();
+
+    blank = AlbumCover::blank(c_width, c_height);
+}
+
+void CoverStore::clear(void) {
+    cache.clear();
+}
+
+bool CoverStore::find(uint32_t idx, QImage &image) {
+    QImage *i = cache.object(idx);
+
+    if (!i) {
+        s_misses++;
+        return false;
+    }
+
+    s_hits++;
+    image = *i;
+
+    return true;
+}
+
+bool CoverStore::contains(uint32_t idx) const {
+    return cache.contains(idx);
+}
+
+void CoverStore::insert(uint32_t idx, const QImage &image) {
+    uint32_t n = cache.count() - cache.contains(idx);
+
+    if (cache.insert(idx, new QImage(image), image.byteCount()))
+        s_evictions += n + 1 - cache.count();
+}
+
+/*
+ * What a cover looks like until it's loaded (same size as a processed
+ * one, so it projects the same).
+ */
+
+const QImage &CoverStore::placeholder(void) const {
+    return blank;
+}
+
+bool CoverStore::isPlaceholder(const QImage &image) const {
+    return image.cacheKey() == blank.cacheKey();
+}
+
+uint32_t CoverStore::hits(void) const {
+    return s_hits;
+}
+
+uint32_t CoverStore::misses(void) const {
+    return s_misses;
+}
+
+uint32_t CoverStore::evictions(void) const {
+    return s_evictions;
+}
+
+void CoverStore::resetStats(void) {
+    s_hits = s_misses = s_evictions = 0;
+}
+
+/* ------------- */
+
+CoverLoader::CoverLoader(QObject *parent) : QThread(parent) {
+    disk = NULL;
+    c_width = c_height = 0;
+    generation = 0;
+    stopping = false;
+}
+
+CoverLoader::~CoverLoader(void) {
+    stop();
+}
+
+/*
+ * Finish the cover in hand (if any) and exit the thread.
+ */
+
+void CoverLoader::stop(void) {
+    lock.lock();
+    stopping = true;
+    jobs.clear();
+    queued.clear();
+    wake.wakeAll();
+    lock.unlock();
+
+    wait();
+}
+
+/*
+ * Freshly processed covers get written here too.
+ */
+
+void CoverLoader::setCache(CoverCache *disk_) {
+    disk = disk_;
+}
+
+/*
+ * Anything queued or in flight was for the old size; results carry
+ * the generation they were made for, so stale ones can be dropped.
+ */
+
+void CoverLoader::setCoverSize(uint16_t c_width_, uint16_t c_height_) {
+    QMutexLocker l(&lock);
+
+    c_width  = c_width_;
+    c_height = c_height_;
+    generation++;
+
+    jobs.clear();
+    queued.clear();
+}
+
+/*
+ * Queue a cover for loading; urgent ones (visible right now) jump the
+ * queue.
+ */
+
+void CoverLoader::request(uint32_t idx, const AlbumCover &a, bool urgent) {
+    QMutexLocker l(&lock);
+
+    if (queued.contains(idx))
+        return;
+
+    job_t j = { idx, a };
+    j.cover.image = QImage();
+
+    if (urgent)
+        jobs.prepend(j);
+    else
+        jobs.append(j);
+
+    queued.insert(idx);
+    wake.wakeOne();
+
+    if (!isRunning())
+        start(QThread::LowPriority);
+}
+
+/*
+ * Drop whatever hasn't been started yet.
+ */
+
+void CoverLoader::cancel(void) {
+    QMutexLocker l(&lock);
+
+    jobs.clear();
+    queued.clear();
+}
+
+bool CoverLoader::isQueued(uint32_t idx) {
+    QMutexLocker l(&lock);
+    return queued.contains(idx);
+}
+
+uint32_t CoverLoader::pending(void) {
+    QMutexLocker l(&lock);
+    return jobs.size();
+}
+
+uint32_t CoverLoader::current(void) {
+    QMutexLocker l(&lock);
+    return generation;
+}
+
+void CoverLoader::run(void) {
+    lock.lock();
+
+    while (!stopping) {
+        if (jobs.isEmpty()) {
+            wake.wait(&lock);
+            continue;
+        }
+
+        job_t j = jobs.takeFirst();
+        uint16_t w = c_width, h = c_height;
+        uint32_t gen = generation;
+
+        lock.unlock();
 
-    for (uint16_t y = c_height; y < stop; y++) {
-        px = (uint32_t*)out.scanLine(y);
-        f = (stop-y)*100/stop;
+        TraceSpan t("load", j.idx);
 
-        for (uint16_t x = 0; x < c_width; x++) {
-            r = qRed(px[x])   * f / 100;
-            g = qGreen(px[x]) * f / 100;
-            b = qBlue(px[x])  * f / 100;
-            px[x] = qRgb(r, g, b);
+        if (!j.cover.load(w, h)) {
+            j.cover.image = AlbumCover::blank(w, h);
+        } else if (disk && j.cover.source.isNull()) {
+            disk->append(j.cover, j.cover.image, w, h);
         }
+
+        lock.lock();
+
+        queued.remove(j.idx);
+        emit loaded(j.idx, j.cover.image, gen);
     }
 
-    image = out;
+    lock.unlock();
 }
 
 /* ------------- */
@@ -127,7 +565,7 @@ void AlbumCover::process(uint16_t c_width, uint16_t c_height) {
 /* ------------- */
 
 AlbumBrowser::AlbumBrowser(QWidget *parent) : AsyncRender(parent) {
-    LOG.puke("albumBrowser");
+    PS_PUKE("albumBrowser");
     c_zoom   = 100;
     c_width  = 135;
     c_height = 175;
@@ -135,19 +573,88 @@ AlbumBrowser::AlbumBrowser(QWidget *parent) : AsyncRender(parent) {
     f_frame     = 0;
     f_direction = 0;
 
+    c_focus  = 0;
+    r_reach  = 1;
+    r_factor = 0;
+    r_arrlo  = 0;
+    r_arrhi  = -1;
+
     d_mode = M_BROWSE;
+
+    store.setCoverSize(c_width, c_height);
+    loader.setCoverSize(c_width, c_height);
+    r_pinlo = 0;
+    r_pinhi = -1;
+
+    loader.setCache(&disk);
+
+    QObject::connect(&loader, SIGNAL(loaded(uint, QImage, uint)),
+                     this, SLOT(coverLoaded(uint, QImage, uint)),
+                     Qt::QueuedConnection);
+
+    /*
+     * Single core targets keep the plain serial renderer.
+     */
+
+    int cores = QThread::idealThreadCount();
+    r_strips  = (cores > 1) ? cores * strips_per_core : 1;
+    r_pool.setMaxThreadCount(qMax(cores - 1, 1));
+
+    r_out   = NULL;
+    r_xstep = r_ystep = 0;
+    r_bits  = NULL;
+    r_bpl   = 0;
+
+    r_projected = false;
+    r_projfocus = 0;
+
+    r_lod      = 0;
+    r_projlod  = 0;
+    r_adaptive = true;
+
+    r_frames.setMaxCost(frame_cache_budget);
+    r_frameshown = frame_none;
+
+    r_prerendering = false;
+
+    /*
+     * Whatever fill(Qt::black) actually writes with this version of
+     * Qt, so strips can clear their own columns identically.
+     */
+
+    QImage px(1, 1, PIXEL_FORMAT);
+    px.fill(Qt::black);
+    r_black = *(const pixel_t *)((const QImage &)px).scanLine(0);
 }
 
 AlbumBrowser::~AlbumBrowser(void) {
+    stopRendering();
+    r_pool.waitForDone();
+
+    /*
+     * Nothing may still be looking at the cache's mapping when it's
+     * closed.
+     */
+
+    loader.stop();
+
+    store.clear();
+    pinCovers(0, -1);
+    cover = bg = QImage();
+
+    disk.close(covers);
 }
 
 bool AlbumBrowser::init(void) {
+    TraceSpan t("init");
+
 #if TEST
     QSize screenSize(800, 400);
 #else
     QSize screenSize(320, 240);
 #endif
 
+#if !HEADLESS
     /*
      * Splash screen.
      */
@@ -158,6 +665,7 @@ bool AlbumBrowser::init(void) {
     QSplashScreen splash(pixmap);
     splash.show();
     splash.showMessage("Booting...", Qt::AlignLeft, Qt::white);
+#endif
 
     QDir dir = QDir::current();
     if (!dir.cd("pics"))
@@ -166,21 +674,26 @@ bool AlbumBrowser::init(void) {
     dir.setFilter(QDir::Files | QDir::Hidden | QDir::NoSymLinks);
 
     QFileInfoList list = dir.entryInfoList();
-    if (list.empty()) {
-        LOG.error("no pics in dir %s", dir.path().toAscii().data());
-        return false;
-    }
 
-    foreach (QFileInfo i, list) {
-        QString msg = "Loaded %1", file = i.absoluteFilePath();
+    /*
+     * Only the paths are collected here; images come from the cover
+     * cache or are decoded in the background as they're needed (see
+     * CoverLoader).  The cover cache itself (and its temporary while
+     * compacting) lives in here too.
+     */
 
-        if (addCover(file)) {
-            LOG.puke("loaded %s", (const char *)file.toAscii());
-            splash.showMessage(msg.arg(file), Qt::AlignLeft, Qt::white);
-        }
+    QString cache = cover_cache_file;
+
+    foreach (QFileInfo i, list)
+        if (i.fileName() != cache && i.fileName() != cache + ".new")
+            addCover(i);
+
+    if (covers.empty()) {
+        LOG.error("no pics in dir %s", dir.path().toAscii().data());
+        return false;
     }
 
-    splash.finish(this);
+    LOG.info("found %u covers", covers.size());
 
     /*
      * Set some dimensions and title.
@@ -190,27 +703,75 @@ bool AlbumBrowser::init(void) {
     setWindowTitle("PopStation");
     resize(screenSize);
 
-    return true;
-}
-
+    disk.open(dir.filePath(cover_cache_file));
 
-void AlbumBrowser::displayAlbum(void) {
     /*
-     * Make a smaller copy of the cover's image and un-distort it to
-     * simplify drawing.
+     * Get the covers around the initial focus loaded before showing
+     * anything; the rest stream in behind.
      */
 
-    bg    = buffer.copy();
-    cover = currentCover().image.copy(0, 0, cover.size().width(), cover.size().height());
+#if !HEADLESS
+    splash.showMessage("Loading covers...", Qt::AlignLeft, Qt::white);
+#endif
 
-    /*
-     * Calculate initial position on-screen (should mimic whatever
-     * renderBrowse() would do for c_focus), and derive x/y slope
-     * components + x_incr for each animation transition (10% per
-     * iteration).
-     */
+    c_focus = covers.size()/2;
+    prefetchCovers();
 
-    QSize cs = coverSize();
+    waitForCovers(c_focus - boot_covers, c_focus + boot_covers);
+
+#if !HEADLESS
+    splash.finish(this);
+#endif
+
+    return true;
+}
+
+/*
+ * Block (running the event loop) until covers[lo..hi] are in the
+ * store, or at least aren't queued any more.
+ */
+
+void AlbumBrowser::waitForCovers(int32_t lo, int32_t hi) {
+    TraceSpan t("waitForCovers");
+
+    lo = qMax(lo, 0);
+    hi = qMin(hi, covers.size() - 1);
+
+    for (int32_t i = lo; i <= hi; i++)
+        prefetchCover(i);
+
+    for (int32_t i = lo; i <= hi; i++)
+        while (!store.contains(i) && loader.isQueued(i))
+            QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+
+    QCoreApplication::processEvents();
+}
+
+
+void AlbumBrowser::displayAlbum(void) {
+    /*
+     * Make a smaller copy of the cover's image and un-distort it to
+     * simplify drawing.
+     */
+
+    bg    = buffer.copy();
+
+    span_t live = { 0, (int16_t)(qMin(buffer.width(), bg.width()) - 1) };
+    d_live.fill(live, bg.height());
+#if COLUMN_MAJOR
+    cover = AlbumCover::transposed(currentCover().image, AlbumCover::rows(c_height), c_width, 0);
+#else
+    cover = currentCover().image.copy(0, 0, c_width, AlbumCover::rows(c_height));
+#endif
+
+    /*
+     * Calculate initial position on-screen (should mimic whatever
+     * renderBrowse() would do for c_focus), and derive x/y slope
+     * components + x_incr for each animation transition (10% per
+     * iteration).
+     */
+
+    QSize cs = coverSize();
 
     d_albumx = (buffer.size().width() - cs.width())   / 2;
     d_albumy = (buffer.size().height() - cs.height()) / 2;
@@ -231,6 +792,8 @@ void AlbumBrowser::displayAlbum(void) {
 void AlbumBrowser::arrangeCovers(int32_t factor) {
     AlbumCover *a;
 
+    r_projected = false;
+
     /*
      * factor != 0 is a transition state; when 0 there is no
      * transition and we should reset whatever ray info might
@@ -243,30 +806,47 @@ void AlbumBrowser::arrangeCovers(int32_t factor) {
         a->cx    = 0;
         a->cy    = 0;
 
-        f_frame  = c_focus << 16;
+        f_frame  = (int64_t)c_focus << 16;
+        r_lod    = 0;
     }
 
-    for (int16_t i = c_focus - 1; i != -1; i--) {
-        a = &covers[i];
-        a->angle = tilt_factor;
-        a->cx    = -(r_offsetX + (spacing_offset*(c_focus-1-i)*FPreal_ONE) + factor);
-        a->cy    = r_offsetY;
+    r_factor = factor;
+    r_arrlo  = qMax(c_focus - r_reach, 0);
+    r_arrhi  = qMin(c_focus + r_reach, covers.size() - 1);
 
-        LOG.puke("cover[%u] = %i, %i, %i", i, a->angle, a->cx, a->cy);
-    }
+    for (int32_t i = c_focus - 1; i >= r_arrlo; i--)
+        placeCover(i);
+
+    for (int32_t i = c_focus + 1; i <= r_arrhi; i++)
+        placeCover(i);
+}
+
+/*
+ * Position of a cover either side of the focus, straight from its
+ * index (and the current transition factor).
+ */
+
+void AlbumBrowser::placeCover(int32_t i) {
+    AlbumCover *a = &covers[i];
 
-    for (uint16_t i = c_focus + 1; i < covers.size(); i++) {
-        a = &covers[i];
+    if (i < c_focus) {
+        a->angle = tilt_factor;
+        a->cx    = -(r_offsetX + (spacing_offset*(c_focus-1-i)*FPreal_ONE) + r_factor);
+        a->cy    = r_offsetY;
+    } else {
         a->angle = -tilt_factor;
-        a->cx    = r_offsetX + (spacing_offset*(i-c_focus-1)*FPreal_ONE) - factor;
+        a->cx    = r_offsetX + (spacing_offset*(i-c_focus-1)*FPreal_ONE) - r_factor;
         a->cy    = r_offsetY;
-
-        LOG.puke("cover[%u] = %i, %i, %i", i, a->angle, a->cx, a->cy);
     }
+
+    PS_PUKE("cover[%u] = %i, %i, %i", i, a->angle, a->cx, a->cy);
 }
 
 void AlbumBrowser::prepRender(bool reset) {
-    LOG.puke("prepRender(%u)", reset);
+    PS_PUKE("prepRender(%u)", reset);
+    TraceSpan t("prepRender");
+
+    r_projected = false;
 
     uint16_t width  = (buffer.size().width()  + 1) / 2;
     uint16_t height = (buffer.size().height() + 1) / 2;
@@ -286,6 +866,20 @@ void AlbumBrowser::prepRender(bool reset) {
         ((c_width / 2) * fsin(tilt_factor)) +
         (c_width * FPreal_ONE / 4);
 
+    /*
+     * Side covers all sit at depth r_offsetY, spacing_offset apart,
+     * so at most (w/2) / (on-screen spacing) of them fit either side;
+     * a few more for the focus and whatever is in transition.
+     */
+
+    int32_t distance = buffer.height() * 100 / c_zoom;
+    int64_t spacing  = (int64_t)spacing_offset * buffer.height() * FPreal_ONE /
+                       ((int64_t)distance * FPreal_ONE + r_offsetY);
+
+    r_reach = (buffer.width() / 2) / qMax(spacing, (int64_t)1) + 3;
+
+    PS_PUKE("reach = %i", r_reach);
+
     if (reset)
         c_focus = covers.size()/2;
 
@@ -293,167 +887,773 @@ void AlbumBrowser::prepRender(bool reset) {
 }
 
 void AlbumBrowser::render(void) {
-    LOG.puke("render");
+    PS_PUKE("render");
+
+    StageTimer t(CTimings::S_RENDER);
+    QRect dirty;
 
     switch (d_mode) {
         case M_BROWSE: {
-            renderBrowse();
+            dirty = renderBrowse();
         } break;
         case M_DISPLAY: {
             renderDisplay();
+            dirty = buffer.rect();
         } break;
     };
 
     /*
-     * Then tell the Widget to update itself at next opportunity.
+     * The timing HUD goes on top of whatever was drawn.
+     */
+
+    if (TIMING.showingHud()) {
+        r_hud = TIMING.drawHud(buffer);
+        damageRect(r_hud);
+        dirty |= r_hud;
+    }
+
+    /*
+     * Then tell the Widget to update whatever changed at next
+     * opportunity.
      */
 
-    QWidget::update();
+    if (!dirty.isEmpty())
+        AsyncRender::update(dirty);
+
+    /*
+     * Settled: get the neighbouring frames ready while nothing else
+     * is going on (on the render thread, if there is one).
+     */
+
+    if (atRest())
+        doIdle();
 }
 
-void AlbumBrowser::renderDisplay(void) {
-    LOG.puke("** renderDisplay");
+void AlbumBrowser::renderDisplay(void) {
+    PS_PUKE("** renderDisplay");
+
+    /*
+     * We're drawing all over the browse view.
+     */
+
+    damageAll();
+
+    /*
+     * Faux-fade the background
+     * Draw album cover
+     *
+     * TODO: we may need to scale the image down on smaller interfaces
+     * to leave room for other stuff.  If so, should be some % of
+     * current size, maintaining existing aspect ratio.
+     */
+
+    QPainter p(&buffer);
+
+    /*
+     * Currently transitioning.
+     */
+
+    if (d_albumx == d_targetx && d_albumy == d_targety) {
+
+        /*
+         * This is our "final" render, animation should be in position
+         * so draw the polish & navigation elements.
+         *
+         * TODO: come up with a better way to "initialize" drawing of
+         * static elements that we don't have to worry about being
+         * overwritten by the manual animation (wish we had sprites).
+         */
+
+        buffer.fill(Qt::black);
+
+        QPen border_pen(Qt::blue, 2, Qt::SolidLine, Qt::FlatCap, Qt::BevelJoin);
+        QPen text_pen(Qt::white, 1, Qt::SolidLine, Qt::FlatCap, Qt::BevelJoin);
+
+        QRect rect(2, 2, buffer.size().width()-3, buffer.size().height()-3);
+        p.setPen(border_pen);
+        p.drawRect(rect);
+
+        QFont font("Times", 12, QFont::Normal);
+        p.setPen(text_pen);
+        p.setFont(font);
+        p.drawText(c_width + 50, 50, "You all should suckit, bitches.");
+
+    } else {
+
+        /*
+         * As we faux-fade, every loop iteration will appear to
+         * accelerate, more noticably in the final ones, because we
+         * don't waste the calculations on pixels that are already
+         * black (so some pixels fade to black sooner than others).
+         *
+         * This will give the user the impression of a scaled
+         * acceleration animation effect.
+         */
+
+        uint16_t y_lim = qMin(buffer.size().height(), bg.size().height());
+
+        pixel_t *in_px      = (pixel_t*)bg.bits();
+        uint32_t in_pxstep  = bg.bytesPerLine() / sizeof(pixel_t);
+
+        uint8_t f = d_albumx * 100 / d_sx;
+
+        /*
+         * Rows (and row ends) that have gone black stay black, so
+         * only the live span of each row is faded (see pixops.cc),
+         * and then trimmed for next time.
+         */
+
+        for (uint16_t y = 0; y < y_lim; y++, in_px += in_pxstep) {
+            span_t &s = d_live[y];
+
+            if (s.lo > s.hi)
+                continue;
+
+            fadeSpan(in_px + s.lo, s.hi - s.lo + 1, f);
+            trimSpan(in_px, &s.lo, &s.hi);
+        }
+
+        p.drawImage(0, 0, bg);
+    }
+
+    /*
+     * Finally, draw the album cover.
+     */
+
+    p.drawImage(QPoint(d_albumx, d_albumy), cover);
+}
+
+QRect AlbumBrowser::renderBrowse(void) {
+    PS_PUKE("** renderBrowse");
+
+    if (!r_projected || r_projfocus != c_focus || r_projlod != lod()) {
+        StageTimer t(r_prerendering ? CTimings::S_MAX : CTimings::S_PROJECT);
+        projectCovers();
+    }
+
+    r_bits = buffer.bits();
+    r_bpl  = buffer.bytesPerLine();
+
+#if COLUMN_MAJOR
+    r_out   = (pixel_t*)r_scratch.bits();
+    r_xstep = r_scratch.bytesPerLine() / sizeof(pixel_t);
+    r_ystep = 1;
+#else
+    r_out   = (pixel_t*)r_bits;
+    r_xstep = 1;
+    r_ystep = r_bpl / sizeof(pixel_t);
+#endif
+
+    QRect dirty;
+    StageTimer t(r_prerendering ? CTimings::S_MAX : CTimings::S_DRAW);
+
+    /*
+     * At rest on a focus we have a frame for (at this size): start
+     * from that rather than from whatever is on screen.
+     */
+
+    bool    rest = atRest();
+    quint64 key  = frameKey(c_focus);
+    bool    hit  = rest && key != r_frameshown && restoreFrame(key);
+
+    if (r_strips > 1)
+        dirty = renderStrips();
+    else
+        dirty = renderStrip(0, buffer.width()-1);
+
+    PS_PUKE("dirty: [%i, %i]%s", dirty.left(), dirty.right(), hit ? " (cached frame)" : "");
+
+    if (rest) {
+        if (!dirty.isEmpty() || !r_frames.contains(key))
+            storeFrame(key, dirty);
+        r_frameshown = key;
+    } else {
+        r_frameshown = frame_none;
+    }
+
+    if (hit)
+        dirty = buffer.rect();
+
+    return dirty;
+}
+
+/*
+ * Work out which cover owns which screen column, starting with the
+ * in-focus cover.
+ */
+
+void AlbumBrowser::projectCovers(void) {
+    PS_PUKE("** projectCovers");
+
+    r_proj.clear();
+    r_projlod = lod();
+
+    uint16_t x_bound;
+    int32_t lo = c_focus, hi = c_focus;
+    QRect r, rc;
+
+    fetchCover(c_focus);
+    r = projectCover(covers[c_focus]);
+    PS_PUKE("initial bound: [%u, %u]", r.left(), r.right());
+
+    /*
+     * Then all remaining covers, left-side right-to-left, and
+     * right-side left-to-right.
+     */
+
+    x_bound = r.left();
+    for (int32_t i = c_focus - 1; i != -1; i--) {
+        PS_PUKE("projecting cover %i", i);
+        if (i < r_arrlo)
+            placeCover(i);
+        fetchCover(lo = i);
+        rc = projectCover(covers[i], 0, x_bound-1);
+        if (rc.isEmpty()) {
+            PS_PUKE("didn't project cover %u, stopping", i);
+            break;
+        }
+
+        x_bound = rc.left();
+    }
+
+    x_bound = r.right();
+    for (int32_t i = c_focus + 1; i < covers.size(); i++) {
+        PS_PUKE("projecting cover %i", i);
+        if (i > r_arrhi)
+            placeCover(i);
+        fetchCover(hi = i);
+        rc = projectCover(covers[i], x_bound+1, buffer.width());
+        if (rc.isEmpty()) {
+            PS_PUKE("didn't project cover %u, stopping", i);
+            break;
+        }
+
+        x_bound = rc.right();
+    }
+
+    pinCovers(lo, hi);
+
+    /*
+     * Index the projections by screen column; -1 if none lands there,
+     * -2 if more than one does.
+     */
+
+    r_colproj.fill(-1, buffer.width());
+
+    for (int32_t i = 0; i < r_proj.size(); i++) {
+        int32_t &c = r_colproj[r_proj[i].x];
+        c = (c == -1) ? i : -2;
+    }
+
+    r_projected = true;
+    r_projfocus = c_focus;
+}
+
+/*
+ * Make sure a cover has its processed image.
+ */
+
+const QImage &AlbumBrowser::fetchCover(int32_t i) {
+    AlbumCover &a = covers[i];
+
+    if (a.image.isNull() || (store.isPlaceholder(a.image) && store.contains(i))) {
+        QImage image;
+
+        if (store.find(i, image)) {
+            a.image = image;
+        } else if (disk.find(a, image)) {
+            store.insert(i, image);
+            a.image = image;
+        } else {
+            a.image = store.placeholder();
+            loader.request(i, a, true);
+        }
+    }
+
+    return a.image;
+}
+
+/*
+ * Only covers[lo..hi] (the ones renderBrowse() can reach) hold on to
+ * their images; everything else lives in the store, if at all.
+ */
+
+void AlbumBrowser::pinCovers(int32_t lo, int32_t hi) {
+    for (int32_t i = r_pinlo; i <= r_pinhi && i < covers.size(); i++)
+        if (i < lo || i > hi)
+            covers[i].image = QImage();
+
+    r_pinlo = lo;
+    r_pinhi = hi;
+}
+
+/*
+ * Get covers nearest the focus first, as many as the store can hold:
+ * straight from the cover cache if they're there, otherwise queued
+ * for the loader (replacing whatever was queued for the previous
+ * focus).
+ */
+
+void AlbumBrowser::prefetchCovers(void) {
+    uint32_t bytes = qMax(store.placeholder().byteCount(), 1);
+    int32_t n = qMax(store.budget() / bytes, (uint32_t)1) / 2;
+
+    loader.cancel();
+
+    for (int32_t d = 0; d <= n; d++) {
+        int32_t l = c_focus - d, r = c_focus + d;
+
+        if (r < covers.size())
+            prefetchCover(r);
+        if (d && l >= 0)
+            prefetchCover(l);
+    }
+}
+
+void AlbumBrowser::prefetchCover(int32_t i) {
+    QImage image;
+
+    if (store.contains(i))
+        return;
+
+    if (disk.find(covers[i], image))
+        store.insert(i, image);
+    else
+        loader.request(i, covers[i]);
+}
+
+/*
+ * A cover came back from the loader.  If it's on screen, swap out the
+ * placeholder (the damage tracking redraws just its columns).
+ */
+
+void AlbumBrowser::coverLoaded(uint idx, QImage image, uint gen) {
+    PS_PUKE("coverLoaded(%u)", idx);
+    TraceSpan t("coverLoaded", idx);
+    QMutexLocker l(stateLock());
+
+    if (gen != loader.current() || (int32_t)idx >= covers.size())
+        return;
+
+    store.insert(idx, image);
+
+    if ((int32_t)idx < r_pinlo || (int32_t)idx > r_pinhi)
+        return;
+
+    covers[idx].image = image;
+
+    if (d_mode == M_BROWSE && !animating())
+        doRender();
+}
+
+/*
+ * Split the screen into vertical strips and hand them to the pool,
+ * keeping the last one for ourselves.  Each column is drawn by the
+ * same covers in the same order whichever strip it lands in, so the
+ * output is identical to the serial path.
+ */
+
+QRect AlbumBrowser::renderStrips(void) {
+    PS_PUKE("** renderStrips");
+
+    int16_t w      = buffer.width();
+    int16_t strips = qMin((int)r_strips, qMax(w / strip_min_width, 1));
+    int16_t lb     = 0;
+
+    QVector<QRect> dirty(strips);
+
+    /*
+     * Strips start on even columns, so a doubled-up column (reduced
+     * quality) is always in the same strip as the one it copies.
+     */
+
+    for (int16_t i = 0; i < strips; i++) {
+        int16_t rb = (i == strips-1) ? w-1 : (((int32_t)w * (i+1) / strips) & ~1) - 1;
+
+        if (i == strips-1)
+            dirty[i] = renderStrip(lb, rb);
+        else
+            r_pool.start(new StripRender(this, lb, rb, &dirty[i]));
+
+        lb = rb + 1;
+    }
+
+    r_pool.waitForDone();
+
+    QRect r;
+    for (int16_t i = 0; i < strips; i++)
+        r |= dirty[i];
+
+    return r;
+}
+
+/*
+ * Bring screen columns [lb, rb] up to date with the projection,
+ * returning the columns that actually changed.  Runs on pool
+ * threads.
+ */
+
+QRect AlbumBrowser::renderStrip(int16_t lb, int16_t rb) {
+    TraceSpan t("strip", lb);
+    int16_t h = buffer.height();
+    int16_t dl = rb + 1, dr = lb - 1;
+    int16_t top, bottom;
+    bool moved = false;
+
+    for (int16_t x = lb; x <= rb; x++) {
+        drawn_t &d  = r_drawn[x];
+        int32_t idx = r_colproj[x];
+        bool left   = moved;
+
+        moved = false;
+
+        if (r_projlod && (x & 1)) {
+
+            /*
+             * Reduced quality: a copy of the column to the left,
+             * unless it already is one and that didn't change.
+             */
+
+            const drawn_t &l = r_drawn[x-1];
+
+            if (!left && d.key == drawn_copy)
+                continue;
+
+            clearColumn(x, d.top, qMin(d.bottom, (int16_t)(l.top-1)));
+            clearColumn(x, qMax(d.top, (int16_t)(l.bottom+1)), d.bottom);
+            copyColumn(x, l.top, l.bottom);
+
+            d.key  = drawn_copy;
+            top    = l.top;
+            bottom = l.bottom;
+
+        } else if (idx >= 0) {
+
+            /*
+             * One cover: skip it if it's the same column of the same
+             * image at the same scale, otherwise draw it and clear
+             * whatever it doesn't cover from last time.
+             */
+
+            const projection_t &p = r_proj[idx];
+            qint64 key = p.cover->image.cacheKey();
+
+            if (d.key == key && d.column == p.column && d.dy == p.dy && d.level == p.level)
+                continue;
+
+            renderColumn(p, top, bottom);
+
+            clearColumn(x, d.top, qMin(d.bottom, (int16_t)(top-1)));
+            clearColumn(x, qMax(d.top, (int16_t)(bottom+1)), d.bottom);
+
+            d.key    = key;
+            d.column = p.column;
+            d.dy     = p.dy;
+            d.level  = p.level;
+
+        } else if (idx == -1) {
+
+            /*
+             * Nothing here; make sure it's black.
+             */
+
+            if (d.top > d.bottom)
+                continue;
+
+            clearColumn(x, d.top, d.bottom);
+
+            d.key  = 0;
+            top    = 0;
+            bottom = -1;
+
+        } else {
+
+            /*
+             * Overlapping covers (rare): redraw them all in order.
+             */
+
+            clearColumn(x, d.top, d.bottom);
+
+            top    = h;
+            bottom = -1;
+
+            for (int32_t i = 0; i < r_proj.size(); i++) {
+                if (r_proj[i].x != x)
+                    continue;
+
+                int16_t t, b;
+                renderColumn(r_proj[i], t, b);
+                top    = qMin(top, t);
+                bottom = qMax(bottom, b);
+            }
+
+            d.key = 0;
+        }
+
+        d.top    = top;
+        d.bottom = bottom;
+        moved    = true;
+
+        dl = qMin(dl, x);
+        dr = qMax(dr, x);
+    }
+
+    if (dl > dr)
+        return QRect();
+
+#if COLUMN_MAJOR
+    /*
+     * Copy the changed columns out of the scratch buffer.
+     */
+
+    transposeBlocked((pixel_t*)r_bits + dl, r_bpl / sizeof(pixel_t),
+                     (const pixel_t*)r_out + dl*r_xstep, r_xstep,
+                     h, dr - dl + 1);
+#endif
+
+    return QRect(dl, 0, dr - dl + 1, h);
+}
+
+/*
+ * Black out rows [top, bottom] of a screen column.
+ */
+
+void AlbumBrowser::clearColumn(int16_t x, int16_t top, int16_t bottom) {
+    pixel_t *px = r_out + x*r_xstep + top*r_ystep;
+
+    for (int16_t y = top; y <= bottom; y++) {
+        *px = r_black;
+        px += r_ystep;
+    }
+}
+
+/*
+ * Copy rows [top, bottom] of the screen column to the left into x.
+ */
+
+void AlbumBrowser::copyColumn(int16_t x, int16_t top, int16_t bottom) {
+    pixel_t *px = r_out + x*r_xstep + top*r_ystep;
+
+    for (int16_t y = top; y <= bottom; y++) {
+        *px = px[-r_xstep];
+        px += r_ystep;
+    }
+}
+
+/*
+ * Forget what the browse view holds (resized, or drawn over), so the
+ * next renderBrowse() redraws every column in full.
+ */
+
+void AlbumBrowser::damageAll(void) {
+    drawn_t d = { 0, 0, 0, 0, 0, (int16_t)(buffer.height()-1) };
+    r_drawn.fill(d, buffer.width());
+
+    r_frameshown = frame_none;
+}
+
+/*
+ * Something else drew over r (the timing HUD); have those columns
+ * redrawn, and cleared over r, next time.
+ */
+
+void AlbumBrowser::damageRect(const QRect &r) {
+    for (int16_t x = r.left(); x <= r.right() && x < r_drawn.size(); x++) {
+        drawn_t &d = r_drawn[x];
+
+        if (d.top > d.bottom) {
+            d.top    = r.top();
+            d.bottom = r.bottom();
+        } else {
+            d.top    = qMin(d.top, (int16_t)r.top());
+            d.bottom = qMax(d.bottom, (int16_t)r.bottom());
+        }
+
+        d.key = 0;
+    }
+}
+
+/*
+ * Browsing, and settled on c_focus (nothing in transition).
+ */
+
+bool AlbumBrowser::atRest(void) const {
+    return d_mode == M_BROWSE && f_direction == 0 && r_factor == 0;
+}
+
+/*
+ * Quality to render at; always full once settled.
+ */
+
+uint8_t AlbumBrowser::lod(void) const {
+    return atRest() ? 0 : r_lod;
+}
+
+quint64 AlbumBrowser::frameKey(int32_t focus) const {
+    return ((quint64)(uint32_t)focus << 32) |
+           ((quint64)(uint16_t)buffer.width() << 16) | (uint16_t)buffer.height();
+}
+
+uint32_t AlbumBrowser::frameCost(void) const {
+    return buffer.width() * (buffer.height() * sizeof(pixel_t) + sizeof(drawn_t));
+}
+
+/*
+ * Put a cached resting frame where the columns are drawn, and take
+ * its r_drawn along with it.
+ */
+
+bool AlbumBrowser::restoreFrame(quint64 key) {
+    frame_t *f = r_frames.object(key);
+
+    if (!f)
+        return false;
+
+#if COLUMN_MAJOR
+    QImage &to = r_scratch;
+#else
+    QImage &to = buffer;
+#endif
+
+    const QImage &from = f->image;
+    int32_t bytes = to.width() * sizeof(pixel_t);
 
-    /*
-     * Faux-fade the background
-     * Draw album cover
-     *
-     * TODO: we may need to scale the image down on smaller interfaces
-     * to leave room for other stuff.  If so, should be some % of
-     * current size, maintaining existing aspect ratio.
-     */
+    for (int32_t y = 0; y < to.height(); y++)
+        memcpy(to.scanLine(y), from.scanLine(y), bytes);
 
-    QPainter p(&buffer);
+#if COLUMN_MAJOR
+    transposeBlocked((pixel_t*)r_bits, r_bpl / sizeof(pixel_t),
+                     (const pixel_t*)r_out, r_xstep,
+                     buffer.height(), buffer.width());
+#endif
 
-    /*
-     * Currently transitioning.
-     */
+    r_drawn = f->drawn;
 
-    if (d_albumx == d_targetx && d_albumy == d_targety) {
+    return true;
+}
 
-        /*
-         * This is our "final" render, animation should be in position
-         * so draw the polish & navigation elements.
-         *
-         * TODO: come up with a better way to "initialize" drawing of
-         * static elements that we don't have to worry about being
-         * overwritten by the manual animation (wish we had sprites).
-         */
+/*
+ * Keep the frame just drawn at rest.  If it's cached already, only
+ * dirty (what this render changed) is copied over.
+ */
 
-        buffer.fill(Qt::black);
+void AlbumBrowser::storeFrame(quint64 key, const QRect &dirty) {
+    if (frameCost() > (uint32_t)r_frames.maxCost())
+        return;
 
-        QPen border_pen(Qt::blue, 2, Qt::SolidLine, Qt::FlatCap, Qt::BevelJoin);
-        QPen text_pen(Qt::white, 1, Qt::SolidLine, Qt::FlatCap, Qt::BevelJoin);
+    frame_t *f = r_frames.object(key);
 
-        QRect rect(2, 2, buffer.size().width()-3, buffer.size().height()-3);
-        p.setPen(border_pen);
-        p.drawRect(rect);
+    if (f) {
+#if COLUMN_MAJOR
+        const QImage &from = r_scratch;
 
-        QFont font("Times", 12, QFont::Normal);
-        p.setPen(text_pen);
-        p.setFont(font);
-        p.drawText(c_width + 50, 50, "You all should suckit, bitches.");
+        for (int32_t x = dirty.left(); x <= dirty.right(); x++)
+            memcpy(f->image.scanLine(x) + dirty.top() * sizeof(pixel_t),
+                   from.scanLine(x) + dirty.top() * sizeof(pixel_t),
+                   dirty.height() * sizeof(pixel_t));
+#else
+        const QImage &from = buffer;
 
-    } else {
+        for (int32_t y = dirty.top(); y <= dirty.bottom(); y++)
+            memcpy(f->image.scanLine(y) + dirty.left() * sizeof(pixel_t),
+                   from.scanLine(y) + dirty.left() * sizeof(pixel_t),
+                   dirty.width() * sizeof(pixel_t));
+#endif
+        f->drawn = r_drawn;
 
-        /*
-         * As we faux-fade, every loop iteration will appear to
-         * accelerate, more noticably in the final ones, because we
-         * don't waste the calculations on pixels that are already
-         * black (so some pixels fade to black sooner than others).
-         *
-         * This will give the user the impression of a scaled
-         * acceleration animation effect.
-         */
+        return;
+    }
 
-        uint16_t x_lim = qMin(buffer.size().width(), bg.size().width());
-        uint16_t y_lim = qMin(buffer.size().height(), bg.size().height());
+    f = new frame_t;
 
-        uint32_t *in_px     = (uint32_t*)bg.bits();
-        uint32_t in_pxstep  = bg.bytesPerLine() / 4;
+#if COLUMN_MAJOR
+    f->image = r_scratch.copy();
+#else
+    f->image = buffer.copy();
+#endif
+    f->drawn = r_drawn;
 
-        uint8_t r, g, b, f = d_albumx * 100 / d_sx;
+    r_frames.insert(key, f, frameCost());
+}
 
-        while (y_lim--) {
-            for (uint16_t x = 0; x < x_lim; x++) {
-                if (in_px[x] == 0xFF000000)
-                    continue;
+/*
+ * Idle time at rest: make sure the frames for the covers either side
+ * of the focus are cached, one per slice (see AsyncRender::idleSlice():
+ * on the render thread, with the state held; RENDER_THREAD builds only).
+ * Those already there are touched (nearest last) so that it's the
+ * frames further away that make room.  Returns whether it rendered
+ * one.
+ */
 
-                r = qRed(in_px[x])   * f / 100;
-                g = qGreen(in_px[x]) * f / 100;
-                b = qBlue(in_px[x])  * f / 100;
+bool AlbumBrowser::idleSlice(void) {
+    if (!atRest() || animating() || buffer.isNull() || covers.isEmpty())
+        return false;
 
-                in_px[x] = qRgb(r,g,b);
-            }
+    int32_t fit   = r_frames.maxCost() / qMax(frameCost(), (uint32_t)1) - 1;
+    int32_t reach = qMin(frame_prerender, fit / 2);
+    int32_t next  = -1;
 
-            in_px  += in_pxstep;
-        }
+    for (int32_t d = reach; d > 0; d--) {
+        int32_t n[2] = { c_focus - d, c_focus + d };
 
-        p.drawImage(0, 0, bg);
+        for (int s = 0; s < 2; s++)
+            if (n[s] >= 0 && n[s] < covers.size() && !r_frames.object(frameKey(n[s])))
+                next = n[s];
     }
 
-    /*
-     * Finally, draw the album cover.
-     */
-
-    p.drawImage(QPoint(d_albumx, d_albumy), cover);
-}
+    if (next < 0)
+        return false;
 
-void AlbumBrowser::renderBrowse(void) {
-    LOG.puke("** renderBrowse");
+    prerenderFrame(next);
 
-    /*
-     * Clean out the off-screen buffer and start with the in-focus
-     * cover.
-     */
+    return true;
+}
 
-    buffer.fill(Qt::black);
+/*
+ * Render the resting frame for focus i into a scratch buffer (which
+ * stores it), then put the live view back as it was.
+ */
 
-    uint16_t x_bound;
-    QRect r, rc;
+void AlbumBrowser::prerenderFrame(int32_t i) {
+    PS_PUKE("prerenderFrame(%i)", i);
+    StageTimer t(CTimings::S_PRERENDER);
 
-    r = renderCover(covers[c_focus]);
-    LOG.puke("initial bound: [%u, %u]", r.left(), r.right());
+    int32_t focus = c_focus;
+    quint64 shown = r_frameshown;
+    QVector<drawn_t> drawn = r_drawn;
 
-    /*
-     * Then render all remaining covers, left-side right-to-left, and
-     * right-side left-to-right.
-     */
+    QImage live = buffer;
+    buffer = QImage(live.size(), PIXEL_FORMAT);
+#if COLUMN_MAJOR
+    QImage scratch = r_scratch;
+    r_scratch = QImage(scratch.size(), PIXEL_FORMAT);
+#endif
+    damageAll();
 
-    x_bound = r.left();
-    for (int16_t i = c_focus - 1; i != -1; i--) {
-        LOG.puke("rendering cover %i", i);
-        rc = renderCover(covers[i], 0, x_bound-1);
-        if (rc.isEmpty()) {
-            LOG.puke("didn't render cover %u, stopping", i);
-            break;
-        }
+    c_focus = i;
+    arrangeCovers();
 
-        x_bound = rc.left();
-    }
+    r_prerendering = true;
+    renderBrowse();
+    r_prerendering = false;
 
-    x_bound = r.right();
-    for (uint16_t i = c_focus + 1; i < covers.size(); i++) {
-        LOG.puke("rendering cover %i", i);
-        rc = renderCover(covers[i], x_bound+1, buffer.width());
-        if (rc.isEmpty()) {
-            LOG.puke("didn't render cover %u, stopping", i);
-            break;
-        }
+    c_focus = focus;
+    arrangeCovers();
 
-        x_bound = rc.right();
-    }
+    buffer = live;
+#if COLUMN_MAJOR
+    r_scratch = scratch;
+#endif
+    r_drawn      = drawn;
+    r_frameshown = shown;
 }
 
-QRect AlbumBrowser::renderCover(AlbumCover &a, int16_t lb, int16_t rb) {
-    LOG.puke("renderCover(%i, %i)", lb, rb);
-
-    QRect rect(0, 0, 0, 0);
-    QImage &src = a.image;
+/*
+ * Normalize the [lb, rb] bounds handed to projectCover(); returns
+ * false if there's nothing to render.
+ */
 
-    int16_t sw = src.width();
-    int16_t sh = src.height();
-    int16_t h = buffer.height();
+bool AlbumBrowser::clipCover(int16_t &lb, int16_t &rb) {
     int16_t w = buffer.width();
 
     if (lb > rb)
@@ -465,43 +1665,75 @@ QRect AlbumBrowser::renderCover(AlbumCover &a, int16_t lb, int16_t rb) {
     rb = qMin(rb, (int16_t)(w-1));
 
     if (lb - rb == 0) {
-        LOG.puke("not rendering invisible slide");
-        return rect;
+        PS_PUKE("not rendering invisible slide");
+        return false;
     }
 
+    return true;
+}
+
+/*
+ * Raytrace a cover within screen columns [lb, rb], recording a
+ * projection for each column it lands on.  Returns the span of
+ * columns covered.
+ */
+
+QRect AlbumBrowser::projectCover(const AlbumCover &a, int16_t lb, int16_t rb) {
+    PS_PUKE("projectCover(%i, %i)", lb, rb);
+    TraceSpan t("projectCover");
+
+    QRect rect(0, 0, 0, 0);
+
+    if (!clipCover(lb, rb))
+        return rect;
+
+    int32_t sw = c_width;
+    int32_t h = buffer.height();
+    int32_t w = buffer.width();
+
     FPreal_t sdx = fcos(a.angle);
     FPreal_t sdy = fsin(a.angle);
     FPreal_t xs = a.cx - sw * sdx/2;
     FPreal_t ys = a.cy - sw * sdy/2;
 
+    /*
+     * Products of two fixed-point values (or one and a screen size)
+     * go through 64 bits; they overflow 32 on wide displays.
+     */
+
     int32_t distance = h * 100 / c_zoom;
-    FPreal_t dist = distance * FPreal_ONE;
+    FP::wide_t dist = distance * FPreal_ONE;
 
-    int32_t xi = qMax((FPreal_t)0, FPreal_CAST((w*FPreal_ONE/2) + fdiv(xs*h, dist+ys)));
+    int32_t xi = qMax((FPreal_t)0, FPreal_CAST((w*FPreal_ONE/2) + FP::div((FP::wide_t)xs*h, dist+ys)));
     if (xi >= w)
         return rect;
 
-    LOG.puke("** [ %i ]   %i   [ %i ]", lb, xi, rb);
+    PS_PUKE("** [ %i ]   %i   [ %i ]", lb, xi, rb);
 
     bool flag = false;
     rect.setLeft(xi);
 
-    for (uint16_t x = qMax(xi, (int)lb); x <= rb; x++) {
+    int32_t first = r_proj.size();
+
+    for (int32_t x = qMax(xi, (int32_t)lb); x <= rb; x++) {
+        if (r_projlod && (x & 1))
+            continue;
+
         FPreal_t hity = 0;
         FPreal_t fk = rays[x];
         if (sdy) {
             fk  -= fdiv(sdx,sdy);
-            hity = -fdiv((rays[x]*distance - a.cx + a.cy*sdx/sdy), fk);
+            hity = -FP::div((FP::wide_t)rays[x]*distance - a.cx + (FP::wide_t)a.cy*sdx/sdy, fk);
         }
 
-        dist = distance*FPreal_ONE + hity;
+        dist = (FP::wide_t)distance*FPreal_ONE + hity;
         if (dist < 0)
             continue;
 
-        FPreal_t hitx = fmul(dist, rays[x]);
-        FPreal_t hitdist = fdiv(hitx - a.cx, sdx);
+        FP::wide_t hitx = FP::cast(dist * rays[x]);
+        FPreal_t hitdist = FP::div(hitx - a.cx, sdx);
 
-        int16_t column = sw/2 + FPreal_CAST(hitdist);
+        int32_t column = sw/2 + FPreal_CAST(hitdist);
         if (column >= sw)
             break;
         if (column < 0)
@@ -513,74 +1745,38 @@ QRect AlbumBrowser::renderCover(AlbumCover &a, int16_t lb, int16_t rb) {
         flag = true;
 
         /*
-         * Start drawing covers to the middle buffer, with a slight
-         * offset (.3 of cover height).
-        */
-
-        int16_t out_y1  = h/2;
-        int16_t out_y2  = out_y1 + 1;
-        QRgb *out_px1   = (QRgb*)(buffer.scanLine(out_y1)) + x;
-        QRgb *out_px2   = (QRgb*)(buffer.scanLine(out_y2)) + x;
-        QRgb out_pxstep = out_px2 - out_px1;
-
-        /*
-         * Start drawning from center of cover size (rather than image
-         * size), which assumes no padding but still works if there's
-         * other stuff (like a reflection) beneath.
-         *
          * dy is a fixed-point fractional "tick" inc/decrement that
          * translates input y coords to output y coords
          * (bendy/stretchy effect).
          */
 
-        int16_t dy     = dist / h;
-
-        int32_t in_x   = column;
-        int32_t in_y1  = c_height/2;
-        int32_t in_y2  = in_y1 + 1;
-        int32_t in_p1  = in_y1*FPreal_ONE - dy/2;
-        int32_t in_p2  = in_y2*FPreal_ONE + dy/2;
-        QRgb *in_px1   = (QRgb*)(src.scanLine(in_y1)) + in_x;
-        QRgb *in_px2   = (QRgb*)(src.scanLine(in_y2)) + in_x;
-        QRgb in_pxstep = in_px2 - in_px1;
-
-        /*
-         * Loop over drawing, knowing that it's probably that we'll
-         * hit one end of a cover's scanlines before the other (top
-         * vs. bottom).
-         */
+        projection_t p = { &a, (int16_t)x, (int16_t)column, (int32_t)(dist / h), 0 };
+        r_proj.push_back(p);
+    }
 
-        uint16_t tick;
-        bool y1_room, y2_room;
+    /*
+     * Pick each column's mip level from how many cover pixels one
+     * screen pixel spans: dy down, and the distance to the
+     * neighbouring column across.  A level halves both, so go up one
+     * for every 4x in their product.
+     */
 
-        do {
-            y1_room = (in_y1 >= 0 && out_y1 >= 0);
-            y2_room = (in_y2 < sh && out_y2 < h);
+    uint8_t levels = AlbumCover::levels(c_width, c_height);
 
-            if (y1_room) {
-                *out_px1 = *in_px1;
-                out_y1--;
-                out_px1 -= out_pxstep;
-            }
+    for (int32_t i = first; levels && i < r_proj.size(); i++) {
+        projection_t &p = r_proj[i];
+        int32_t n = (i > first) ? i-1 : i+1;
+        int64_t step = 1;
 
-            if (y2_room) {
-                *out_px2 = *in_px2;
-                out_y2++;
-                out_px2 += out_pxstep;
-            }
+        if (n < r_proj.size())
+            step = qMax(qAbs(p.column - r_proj[n].column) / qAbs(p.x - r_proj[n].x), 1);
 
-            in_p1 -= dy;
-            in_p2 += dy;
+        int64_t span = step * p.dy;
 
-            tick = abs(FPreal_CAST(in_p1) - in_y1);
-            if (tick != 0) {
-                in_y1  -= tick;
-                in_y2  += tick;
-                in_px1 -= in_pxstep*tick;
-                in_px2 += in_pxstep*tick;
-            }
+        while (p.level < levels && span >= ((int64_t)FPreal_ONE << (2*(p.level+1))))
+            p.level++;
 
-        } while (y1_room || y2_room);
+        p.level = qMin((uint8_t)(p.level + r_projlod), levels);
     }
 
     rect.setTop(0);
@@ -589,31 +1785,67 @@ QRect AlbumBrowser::renderCover(AlbumCover &a, int16_t lb, int16_t rb) {
     return rect;
 }
 
+/*
+ * Draw one projected column, returning the rows it covered.
+ *
+ * Start drawing covers to the middle buffer, from the center of the
+ * cover size (rather than image size), which assumes no padding but
+ * still works if there's other stuff (like a reflection) beneath.
+ */
+
+void AlbumBrowser::renderColumn(const projection_t &p, int16_t &top, int16_t &bottom) {
+    uint8_t  l = p.level;
+    uint16_t total_height = AlbumCover::rows(c_height);
+
+#if COLUMN_MAJOR
+    const pixel_t *bits = (const pixel_t*)p.cover->image.bits() +
+                          mipOffset(total_height, c_width, AlbumCover::stride(total_height), l);
+    const pixel_t *in = bits + (p.column >> l) *
+                        (l ? total_height >> l : AlbumCover::stride(total_height));
+    int32_t in_step   = 1;
+#else
+    const pixel_t *bits = (const pixel_t*)p.cover->image.bits() +
+                          mipOffset(c_width, total_height, AlbumCover::stride(c_width), l);
+    const pixel_t *in = bits + (p.column >> l);
+    int32_t in_step   = l ? c_width >> l : AlbumCover::stride(c_width);
+#endif
+
+    drawColumn(r_out + p.x*r_xstep, r_ystep, buffer.height(),
+               in, in_step, total_height >> l, (c_height/2) >> l,
+               p.dy >> l, &top, &bottom);
+}
+
 void AlbumBrowser::animate(void) {
-    LOG.puke("** animate");
+    PS_PUKE("** animate");
+
+    StageTimer t(CTimings::S_ANIMATE);
+
+    uint32_t dt = elapsed();
 
     switch (d_mode) {
         case M_BROWSE: {
-            animateBrowse();
+            animateBrowse(dt);
         } break;
         case M_DISPLAY: {
-            animateDisplay();
+            animateDisplay(dt);
         } break;
     };
 }
 
-void AlbumBrowser::animateDisplay(void) {
-    LOG.puke("** animateDisplay");
+void AlbumBrowser::animateDisplay(uint32_t dt) {
+    PS_PUKE("** animateDisplay");
 
     /*
-     * For now, transition album in 10% increments on X, using the
-     * slope to derive Y.
+     * For now, transition album in 10% increments (per nominal tick)
+     * on X, using the slope to derive Y.
      */
 
-    d_albumx = qMax(d_albumx - d_dx, (int)d_targetx);
+    int32_t dx = qMax((int32_t)((uint64_t)d_dx * dt / tick_usec), 1);
+
+    d_albumx = qMax(d_albumx - dx, (int)d_targetx);
     d_albumy = qMax(d_sy * d_albumx / d_sx, (int)d_targety);
 
-    LOG.debug("animate: [-%u] d_albumx = %u, d_albumy = %u", d_dx, d_albumx, d_albumy);
+    PS_DEBUG("animate: [-%u] d_albumx = %u, d_albumy = %u", d_dx, d_albumx, d_albumy);
 
     if (d_albumx == d_targetx && d_albumy == d_targety)
         doAnimate(false);
@@ -621,10 +1853,10 @@ void AlbumBrowser::animateDisplay(void) {
     doRender();
 }
 
-void AlbumBrowser::animateBrowse(void) {
-    LOG.puke("** animateBrowse");
+void AlbumBrowser::animateBrowse(uint32_t dt) {
+    PS_PUKE("** animateBrowse");
 
-    int16_t c_target = c_focus + f_direction;
+    int32_t c_target = c_focus + f_direction;
 
     /*
      * If target is beyond bounds (e.g. kept clicking left), then let
@@ -635,107 +1867,162 @@ void AlbumBrowser::animateBrowse(void) {
 
     if (c_target < 0 || c_target == covers.size()) {
         c_target = c_focus;
-        f_frame  = c_target << 16;
+        f_frame  = (int64_t)c_target << 16;
     }
 
     /*
-     * Calculate the next "frame" increment and update f_frame.
+     * Under load -- renders taking longer than the frame budget, or
+     * clicks queueing up more than the next cover -- drop to reduced
+     * quality for the rest of the flight.  Settling (arrangeCovers())
+     * brings it back.
      */
 
-    uint32_t f_diff   = qMin( abs(f_frame - (c_target<<16)), (int)f_max);
-    uint32_t f_iangle = IANGLE_MAX * (f_diff-f_max/2) / (f_max*2);
-    uint32_t f_incr   = 512 + (16384 * (FPreal_ONE+fsin(f_iangle))/FPreal_ONE);
-
-    f_frame += f_incr * f_direction;
+    int64_t f_togo = qAbs(((int64_t)c_target << 16) - f_frame);
 
-    LOG.puke("[%u] angle = %i (%i), incr = %i (+%i @%i)", c_focus, f_iangle, f_iangle & IANGLE_MASK, f_incr, f_diff, f_frame);
+    if (r_adaptive && !r_lod && (renderCost() > frameBudget() || f_togo > 65536)) {
+        PS_DEBUG("reduced quality: render %u/%u usec, %lli to go",
+                 renderCost(), frameBudget(), (long long)f_togo);
+        r_lod = 1;
+    }
 
     /*
-     * Update the raytrace data for the cover in transition.
-     *
-     * Frames reference a cover's lb, so (after f_incr'ing) moving
-     * left will reference the next-left cover, which would be wrong.
-     * When moving right, we don't have to worry about that.
+     * Calculate the next "frame" increment (per nominal tick, scaled
+     * to the time that actually passed) and update f_frame.  A long
+     * gap can't carry it past the target: arriving is what stops the
+     * animation.
      */
 
-    int32_t c_idx  = (f_frame >> 16) + (f_direction < 0);
-    int32_t pos    = f_frame & 0xffff;
-    int32_t neg    = 65536 - pos;
-    int32_t  tick  = (f_direction < 0) ? neg : pos;
-    FPreal_t ftick = (tick * FPreal_ONE) >> 16;
+    uint32_t f_diff   = qMin(qAbs(f_frame - ((int64_t)c_target << 16)), (int64_t)f_max);
+    uint32_t f_iangle = IANGLE_MAX * (f_diff-f_max/2) / (f_max*2);
+    uint32_t f_incr   = 512 + (16384 * (int64_t)(FPreal_ONE+fsin(f_iangle))/FPreal_ONE);
 
-    LOG.puke("[%i -> %i] pos = %i, neg = %i, tick = %i, ftick = %i", c_idx, c_target, pos, neg, tick, ftick);
+    f_frame += (int64_t)f_incr * dt / tick_usec * f_direction;
 
-    AlbumCover *a = &(covers[c_idx]);
-    a->angle = (f_direction * tick * tilt_factor) >> 16;
-    a->cx    = -f_direction * fmul(r_offsetX, ftick);
-    a->cy    = fmul(r_offsetY, ftick);
+    if (f_direction > 0)
+        f_frame = qMin(f_frame, (int64_t)c_target << 16);
+    else if (f_direction < 0)
+        f_frame = qMax(f_frame, ((int64_t)c_target << 16) - 1);
+
+    PS_PUKE("[%u] angle = %i (%i), incr = %i (+%i @%lli)", c_focus, f_iangle, f_iangle & IANGLE_MASK, f_incr, f_diff, (long long)f_frame);
 
     /*
      * If we have arrived, then just reset everything and display.
      */
 
-    if (c_idx == c_target) {
+    if (placeFrame(c_target) == c_target) {
 
         doAnimate(false);
 
-        c_focus     = c_idx;
+        c_focus     = c_target;
         f_direction = 0;
 
         arrangeCovers();
 
-    } else {
+        prefetchCovers();
 
-        /*
-         * Otherwise, we're still transitioning.  Update cover angles.
-         */
+        PS_DEBUG("cover cache: %u covers, %u/%u bytes, %u hits, %u misses, %u evictions",
+                  store.count(), store.used(), store.budget(),
+                  store.hits(), store.misses(), store.evictions());
+    }
+
+    doRender();
+}
+
+/*
+ * Update the raytrace data for the covers in transition at f_frame,
+ * on the way to c_target; returns the index of the one the frame is
+ * on (c_target once there, and then nothing else is touched).
+ *
+ * Frames reference a cover's lb, so (after f_incr'ing) moving left
+ * will reference the next-left cover, which would be wrong.  When
+ * moving right, we don't have to worry about that.
+ */
+
+int32_t AlbumBrowser::placeFrame(int32_t c_target) {
+    int32_t c_idx  = (int32_t)(f_frame >> 16) + (f_direction < 0);
+    int32_t pos    = f_frame & 0xffff;
+    int32_t neg    = 65536 - pos;
+    int32_t  tick  = (f_direction < 0) ? neg : pos;
+    FPreal_t ftick = ((int64_t)tick * FPreal_ONE) >> 16;
 
-        int32_t factor = f_direction * spacing_offset * ftick;
+    PS_PUKE("[%i -> %i] pos = %i, neg = %i, tick = %i, ftick = %i", c_idx, c_target, pos, neg, tick, ftick);
 
-        LOG.puke("animating (factor = %i)", factor);
+    AlbumCover *a = &(covers[c_idx]);
+    a->angle = (f_direction * tick * tilt_factor) >> 16;
+    a->cx    = -f_direction * fmul(r_offsetX, ftick);
+    a->cy    = fmul(r_offsetY, ftick);
 
-        arrangeCovers(factor);
+    if (c_idx == c_target)
+        return c_idx;
 
-        if (f_direction > 0) {
-            a        = &(covers[c_idx+1]);
-            a->angle = -(neg * tilt_factor) >> 16;
-            ftick    = (neg * FPreal_ONE) >> 16;
-            a->cx    = fmul(r_offsetX, ftick);
-            a->cy    = fmul(r_offsetY, ftick);
-        } else {
-            a        = &(covers[c_idx-1]);
-            a->angle = (pos * tilt_factor) >> 16;
-            ftick    = (pos * FPreal_ONE) >> 16;
-            a->cx    = -fmul(r_offsetX, ftick);
-            a->cy    = fmul(r_offsetY, ftick);
-        }
+    /*
+     * Still transitioning.  Update cover angles.
+     */
+
+    int32_t factor = f_direction * spacing_offset * ftick;
+
+    PS_PUKE("animating (factor = %i)", factor);
+
+    arrangeCovers(factor);
+
+    if (f_direction > 0) {
+        a        = &(covers[c_idx+1]);
+        a->angle = -(neg * tilt_factor) >> 16;
+        ftick    = ((int64_t)neg * FPreal_ONE) >> 16;
+        a->cx    = fmul(r_offsetX, ftick);
+        a->cy    = fmul(r_offsetY, ftick);
+    } else {
+        a        = &(covers[c_idx-1]);
+        a->angle = (pos * tilt_factor) >> 16;
+        ftick    = ((int64_t)pos * FPreal_ONE) >> 16;
+        a->cx    = -fmul(r_offsetX, ftick);
+        a->cy    = fmul(r_offsetY, ftick);
     }
 
-    doRender();
+    return c_idx;
 }
 
+/*
+ * Covers are only decoded and processed when they come into view
+ * (see fetchCover()), so just check it's something we can read: by
+ * its header, not its name (which may have no suffix, or the wrong
+ * one).
+ */
+
 bool AlbumBrowser::addCover(const QString &path_) {
-    QImage image_;
+    return addCover(QFileInfo(path_));
+}
+
+bool AlbumBrowser::addCover(const QFileInfo &info) {
+    QString path_ = info.absoluteFilePath();
 
-    if (!image_.load(path_)) {
-        LOG.error("unable to load %s", (const char*)path_.toAscii());
+    if (!QImageReader(path_).canRead()) {
+        PS_DEBUG("not an image: %s", (const char*)path_.toAscii());
         return false;
     }
 
-    LOG.puke("loaded cover %s", (const char*)path_.toAscii());
-    addCover(image_, path_);
+    PS_PUKE("added cover %s", (const char*)path_.toAscii());
+
+    AlbumCover a(QImage(), path_);
+    a.mtime = info.lastModified().toTime_t();
+    a.size  = info.size();
+    covers.push_back(a);
+
+    r_projected = false;
 
     return true;
 }
 
 /*
- * Might want to delay "processing" until the image is shown?
+ * Covers with no file behind them keep their unprocessed image.
  */
 
 void AlbumBrowser::addCover(const QImage &image_, const QString &path_) {
-    AlbumCover a(image_, path_);
-    a.process(c_width, c_height);
+    AlbumCover a(QImage(), path_);
+    a.source = image_;
     covers.push_back(a);
+
+    r_projected = false;
 }
 
 void AlbumBrowser::loadCovers(QList<QString> &covers) {
@@ -744,20 +2031,28 @@ void AlbumBrowser::loadCovers(QList<QString> &covers) {
     QImage image;
     foreach (QString filename, covers) {
         if (image.load(filename)) {
-            LOG.debug("loaded cover %s", (const char *)filename.toAscii());
+            PS_DEBUG("loaded cover %s", (const char *)filename.toAscii());
             addCover(image, filename);
         }
     }
 }
 
 void AlbumBrowser::setCoverSize(QSize s) {
-    LOG.puke("setCoverSize(%u, %u)", s.width(), s.height());
+    PS_PUKE("setCoverSize(%u, %u)", s.width(), s.height());
 
     if (s.width() == c_width && s.height() == c_height)
         return;
 
     c_width  = s.width();
     c_height = s.height();
+
+    store.setCoverSize(c_width, c_height);
+    loader.setCoverSize(c_width, c_height);
+    disk.setCoverSize(c_width, c_height);
+    pinCovers(0, -1);
+
+    r_projected = false;
+    r_frames.clear();
 }
 
 QSize AlbumBrowser::coverSize(void) {
@@ -765,17 +2060,96 @@ QSize AlbumBrowser::coverSize(void) {
 }
 
 const AlbumCover &AlbumBrowser::currentCover(void) {
-    LOG.puke("currentCover");
+    PS_PUKE("currentCover");
+
+    fetchCover(c_focus);
 
     return covers[c_focus];
 }
 
+/*
+ * Jump straight to a browse state: focus, and (if direction is set)
+ * tick/65536 of the way into the transition towards its neighbour.
+ * Everything is redrawn at the next render (no cached frames).  For
+ * psbench's golden images.
+ */
+
+void AlbumBrowser::setBrowseState(int32_t focus, int8_t direction, uint16_t tick) {
+    d_mode      = M_BROWSE;
+    bg = cover  = QImage();
+
+    c_focus     = qBound(0, focus, covers.size() - 1);
+    f_direction = direction;
+
+    if (c_focus + direction < 0 || c_focus + direction >= covers.size())
+        f_direction = 0;
+
+    /*
+     * Settled on the focus first; then (arrangeCovers() having reset
+     * f_frame) the covers in transition for the tick.
+     */
+
+    arrangeCovers();
+
+    f_frame = ((int64_t)c_focus << 16) + (int64_t)f_direction * tick;
+    if (f_direction)
+        placeFrame(c_focus + f_direction);
+    r_projected = false;
+    r_frames.clear();
+    damageAll();
+
+    doAnimate(f_direction != 0);
+}
+
+/*
+ * Percent; smaller pulls the camera back.
+ */
+
+void AlbumBrowser::setZoom(uint8_t zoom) {
+    c_zoom = qMax(zoom, (uint8_t)1);
+    r_frames.clear();
+
+    if (!buffer.isNull())
+        prepRender(false);
+}
+
+uint8_t AlbumBrowser::zoom(void) const {
+    return c_zoom;
+}
+
+/*
+ * Whether to drop quality under load (see animateBrowse()); off, every
+ * frame is drawn in full.
+ */
+
+void AlbumBrowser::setAdaptiveQuality(bool on) {
+    r_adaptive = on;
+    r_lod      = 0;
+}
+
+void AlbumBrowser::setCacheBudget(uint32_t bytes) {
+    store.setBudget(bytes);
+}
+
+/*
+ * For resting frames; 0 turns them off.
+ */
+
+void AlbumBrowser::setFrameCacheBudget(uint32_t bytes) {
+    PS_DEBUG("frame cache budget: %u bytes", bytes);
+    r_frames.setMaxCost(bytes);
+}
+
+const CoverStore &AlbumBrowser::coverStore(void) const {
+    return store;
+}
+
 /*
  * (Re)size.  Guaranteed one of these on startup.
  */
 
 void AlbumBrowser::resizeView(const QSize &s, bool reset) {
-    LOG.puke("resizeView(%u, %u)", s.width(), s.height());
+    PS_PUKE("resizeView(%u, %u)", s.width(), s.height());
 
     /*
      * No point in recalculating anything if the size isn't changing.
@@ -784,13 +2158,18 @@ void AlbumBrowser::resizeView(const QSize &s, bool reset) {
     if (buffer.size() == s)
         return;
 
-    buffer = QImage(s, QImage::Format_RGB32);
+    buffer = newBuffer(s);
     buffer.fill(Qt::black);
+#if COLUMN_MAJOR
+    r_scratch = QImage(s.height(), s.width(), PIXEL_FORMAT);
+    r_scratch.fill(Qt::black);
+#endif
+    damageAll();
 
     d_lb = (size().width() / 2) - (c_width / 2);
     d_rb = d_lb + c_width;
 
-    LOG.puke("d_lb = %u, d_rb = %u", d_lb, d_rb);
+    PS_PUKE("d_lb = %u, d_rb = %u", d_lb, d_rb);
 
     /*
      * Regardless of d_mode, we need to update the ray info --
@@ -804,7 +2183,7 @@ void AlbumBrowser::resizeView(const QSize &s, bool reset) {
 }
 
 void AlbumBrowser::resizeEvent(QResizeEvent *e) {
-    LOG.puke("@@ resizeEvent: [%i:%i] -> [%i:%i]",
+    PS_PUKE("@@ resizeEvent: [%i:%i] -> [%i:%i]",
            e->oldSize().width(), e->oldSize().height(),
            e->size().width(),    e->size().height());
 
@@ -817,11 +2196,11 @@ void AlbumBrowser::resizeEvent(QResizeEvent *e) {
 
     this->resizeView(e->size(), reset);
 
-    QWidget::resizeEvent(e);
+    AsyncRender::resizeEvent(e);
 }
 
 void AlbumBrowser::mousePressEvent(QMouseEvent *e) {
-    LOG.debug("@@ mousePressEvent[%u:%u]", e->x(), e->y());
+    PS_DEBUG("@@ mousePressEvent[%u:%u]", e->x(), e->y());
 
     switch (d_mode) {
 
@@ -885,6 +2264,31 @@ void AlbumBrowser::mousePressEvent(QMouseEvent *e) {
 
 }
 
+/*
+ * T toggles the timing HUD.  Like input, this is on the render thread
+ * if there is one, so TIMING isn't changed under render().  Going off,
+ * what the HUD covered is redrawn.
+ */
+
+void AlbumBrowser::keyPressEvent(QKeyEvent *e) {
+    if (e->key() != Qt::Key_T) {
+        AsyncRender::keyPressEvent(e);
+        return;
+    }
+
+    bool on = !TIMING.showingHud();
+    PS_DEBUG("@@ keyPressEvent: timing hud %u", on);
+
+    TIMING.showHud(on);
+
+    if (!on) {
+        damageRect(r_hud);
+        r_hud = QRect();
+    }
+
+    doRender();
+}
+
 /* -------------------------- */
 /* -------------------------- */
 
@@ -8,9 +8,17 @@
 #include <QList>
 #include <QVector>
 #include <QCache>
-
+#include <QFileInfo>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "pixops.hh"
 #include "render.hh"
 #include "fpmath.hh"
+#include "cache.hh"
 
 /*
  * FIXME: some int16_t might need to be int32_t
@@ -20,8 +28,10 @@
 class AlbumCover {
 
 public:
-    QImage image;
+    QImage image;               // processed; only while it might be visible
+    QImage source;              // unprocessed, for covers with no file
     QString path;
+    int64_t mtime, size;        // of path, for the cover cache
 
     int16_t angle;
     FPreal_t cx, cy;
@@ -30,17 +40,120 @@ public:
     AlbumCover(const QImage &, const QString & = "");
     AlbumCover(const AlbumCover &);
 
+    bool load(uint16_t, uint16_t);
     void process(uint16_t, uint16_t);
 
+    static QImage blank(uint16_t, uint16_t);
+    static uint16_t rows(uint16_t);
+    static uint8_t levels(uint16_t, uint16_t);
+    static uint16_t stride(uint16_t);
+    static uint16_t lines(uint16_t, uint16_t, uint8_t);
+    static QImage allocate(uint16_t, uint16_t, uint8_t);
+    static QImage transposed(const QImage &, uint16_t, uint16_t, uint8_t);
+
     const AlbumCover &operator=(const AlbumCover &);
 
 };
 
 /* ---------- */
 
+/*
+ * Processed cover images, kept in an LRU bounded by bytes.  Keyed by
+ * cover index.  Misses are filled in by a CoverLoader; until then a
+ * cover shows the (black) placeholder.
+ */
+
+class CoverStore {
+
+ private:
+    QCache<uint32_t, QImage> cache;
+    QImage blank;
+    uint16_t c_width, c_height;
+
+    uint32_t s_hits, s_misses, s_evictions;
+
+ public:
+
+    CoverStore(uint32_t = 0);
+
+    void setBudget(uint32_t);
+    uint32_t budget(void) const;
+    uint32_t used(void) const;
+    uint32_t count(void) const;
+
+    void setCoverSize(uint16_t, uint16_t);
+    void clear(void);
+
+    bool find(uint32_t, QImage &);
+    bool contains(uint32_t) const;
+    void insert(uint32_t, const QImage &);
+
+    const QImage &placeholder(void) const;
+    bool isPlaceholder(const QImage &) const;
+
+    uint32_t hits(void) const;
+    uint32_t misses(void) const;
+    uint32_t evictions(void) const;
+    void resetStats(void);
+};
+
+/* ---------- */
+
+/*
+ * Background thread that decodes and processes covers, most urgent
+ * first, handing the results back through loaded().
+ */
+
+class CoverLoader : public QThread {
+    Q_OBJECT;
+
+ private:
+
+    typedef struct {
+        uint32_t idx;
+        AlbumCover cover;
+    } job_t;
+
+    QMutex lock;
+    QWaitCondition wake;
+    QList<job_t> jobs;
+    QSet<uint32_t> queued;
+
+    CoverCache *disk;
+    uint16_t c_width, c_height;
+    uint32_t generation;
+    bool stopping;
+
+ protected:
+
+    void run(void);
+
+ public:
+
+    CoverLoader(QObject * = 0);
+    ~CoverLoader(void);
+
+    void setCache(CoverCache *);
+    void setCoverSize(uint16_t, uint16_t);
+    void request(uint32_t, const AlbumCover &, bool = false);
+    void cancel(void);
+    bool isQueued(uint32_t);
+    uint32_t pending(void);
+    uint32_t current(void);
+    void stop(void);
+
+ signals:
+
+    void loaded(uint, QImage, uint);
+};
+
+/* ---------- */
+
 class AlbumBrowser : public AsyncRender {
     Q_OBJECT;
 
+    friend class StripRender;
+
  private:
 
     /* display mode (browse, display) */
@@ -53,58 +166,215 @@ class AlbumBrowser : public AsyncRender {
 
     /* covers */
     QList<AlbumCover> covers;
-    uint8_t  c_zoom, c_focus;
+    uint8_t  c_zoom;
+    int32_t  c_focus;
     uint16_t c_width, c_height;
 
+    /* processed images; covers[r_pinlo..r_pinhi] hold theirs */
+    CoverStore  store;
+    CoverCache  disk;
+    CoverLoader loader;
+    int32_t r_pinlo, r_pinhi;
+
     /* cover display */
     QImage cover, bg;
     uint16_t d_sx, d_sy, d_dx;
     uint16_t d_targetx, d_targety;
     uint16_t d_albumx, d_albumy;
 
+    /*
+     * Per row of bg, the pixels not yet faded to black ([lo, hi];
+     * lo > hi once the whole row is).
+     */
+
+    typedef struct {
+        int16_t lo, hi;
+    } span_t;
+
+    QVector<span_t> d_live;
+
     /* raytracing */
     int8_t  f_direction;
-    int32_t f_frame;
+    int64_t f_frame;
     FPreal_t r_offsetX, r_offsetY;
     QVector<FPreal_t> rays;
 
+    /*
+     * Arrangement: only covers within r_reach of the focus (as many
+     * as could be on screen) are placed each tick; anything past
+     * that is placed from its index if and when it's needed.
+     */
+
+    int32_t r_reach, r_factor;
+    int32_t r_arrlo, r_arrhi;
+
+    /*
+     * Projection: for each visible screen column, which cover and
+     * cover column land there and the vertical step to draw it with.
+     * Only recomputed when covers move (see prepRender(),
+     * arrangeCovers(), setCoverSize()), otherwise rendering is just a
+     * gather over this list.
+     */
+
+    typedef struct {
+        const AlbumCover *cover;
+        int16_t x, column;
+        int32_t dy;
+        uint8_t level;          // mip level to sample
+    } projection_t;
+
+    QVector<projection_t> r_proj;
+    QVector<int32_t> r_colproj;
+    bool    r_projected;
+    int32_t r_projfocus;
+
+    /*
+     * Quality: 0 is full; 1 (under load, for the rest of a flight, see
+     * animateBrowse()) projects every other column, one mip level
+     * down, and doubles them up.  r_projlod is what r_proj was made
+     * with.
+     */
+
+    uint8_t r_lod, r_projlod;
+    bool    r_adaptive;
+
+    /*
+     * Damage tracking: what each screen column currently holds, so
+     * columns whose projection hasn't changed are left alone and the
+     * rest only clear the rows the new draw doesn't cover.
+     */
+
+    typedef struct {
+        qint64  key;
+        int16_t column;
+        int32_t dy;
+        uint8_t level;
+        int16_t top, bottom;
+    } drawn_t;
+
+    QVector<drawn_t> r_drawn;
+
+    /*
+     * Resting frames: the browse view settled on a focus, at a buffer
+     * size, kept in an LRU bounded by bytes together with the r_drawn
+     * that describes them.  Starting from one of those instead of a
+     * full redraw, the damage tracking fixes up anything that has
+     * changed since (a cover that loaded in the meantime).  While
+     * idle, the render thread (if any) prerenders the frames either
+     * side of the focus.
+     */
+
+    typedef struct {
+        QImage image;           // what r_out draws into
+        QVector<drawn_t> drawn;
+    } frame_t;
+
+    QCache<quint64, frame_t> r_frames;
+    quint64 r_frameshown;       // buffer holds this resting frame
+    bool    r_prerendering;     // (not timed as project/draw)
+
+    /* where the timing HUD was last drawn */
+    QRect   r_hud;
+
+    /* strip rendering (multi-core) */
+    QThreadPool r_pool;
+    uint16_t r_strips;
+    pixel_t  r_black;
+
+    /*
+     * Where columns are drawn: pixel (x, y) is r_out[x*r_xstep +
+     * y*r_ystep], which is either buffer itself or (COLUMN_MAJOR) the
+     * transposed r_scratch.
+     */
+
+    QImage   r_scratch;
+    pixel_t *r_out;
+    int32_t  r_xstep, r_ystep;
+    uchar   *r_bits;
+    int32_t  r_bpl;
+
     /* Utility */
     void resizeView(const QSize &, bool reset);
 
-    void renderDisplay(void);
-    void renderBrowse(void);
-    void animateDisplay(void);
-    void animateBrowse(void);
+    void  renderDisplay(void);
+    QRect renderBrowse(void);
+    void animateDisplay(uint32_t);
+    void animateBrowse(uint32_t);
+    int32_t placeFrame(int32_t);
 
     void  prepRender(bool reset);
     void  arrangeCovers(int32_t = 0);
-    QRect renderCover(AlbumCover &, int16_t = -1, int16_t = -1);
-
+    void  placeCover(int32_t);
+    const QImage &fetchCover(int32_t);
+    void  pinCovers(int32_t, int32_t);
+    void  prefetchCovers(void);
+    void  prefetchCover(int32_t);
+
+    void  projectCovers(void);
+    bool  clipCover(int16_t &, int16_t &);
+    QRect projectCover(const AlbumCover &, int16_t = -1, int16_t = -1);
+    QRect renderStrips(void);
+    QRect renderStrip(int16_t, int16_t);
+    void  renderColumn(const projection_t &, int16_t &, int16_t &);
+    void  clearColumn(int16_t, int16_t, int16_t);
+    void  copyColumn(int16_t, int16_t, int16_t);
+    uint8_t lod(void) const;
+    void  damageAll(void);
+    void  damageRect(const QRect &);
+
+    bool    atRest(void) const;
+    quint64 frameKey(int32_t) const;
+    uint32_t frameCost(void) const;
+    bool  restoreFrame(quint64);
+    void  storeFrame(quint64, const QRect &);
+    void  prerenderFrame(int32_t);
+
+
+ private slots:
+
+    void coverLoaded(uint, QImage, uint);
 
  protected slots:
 
     virtual void animate(void);
     virtual void render(void);
 
+ protected:
+
+    virtual bool idleSlice(void);
+
  public:
 
     AlbumBrowser(QWidget * = 0);
     ~AlbumBrowser(void);
 
     bool init(void);
+    void waitForCovers(int32_t, int32_t);
+    void setBrowseState(int32_t, int8_t, uint16_t);
 
     bool addCover(const QString &);
+    bool addCover(const QFileInfo &);
     void addCover(const QImage &, const QString & = "");
     void loadCovers(QList<QString> &);
     void setCoverSize(QSize);
     QSize coverSize(void);
     const AlbumCover &currentCover(void);
 
+    void setZoom(uint8_t);
+    uint8_t zoom(void) const;
+
+    void setAdaptiveQuality(bool);
+
+    void setCacheBudget(uint32_t);
+    void setFrameCacheBudget(uint32_t);
+    const CoverStore &coverStore(void) const;
+
     void displayAlbum(void);
 
     /* Methods to respond to as a QWidget */
     void resizeEvent(QResizeEvent *);
     void mousePressEvent(QMouseEvent *);
+    void keyPressEvent(QKeyEvent *);
 
 };
 
@@ -0,0 +1,673 @@
+/*
+ * $Id$
+ *
+ * Headless renderer benchmark: an AlbumBrowser over synthetic covers,
+ * rendering into its offscreen buffer (no window, no -qws), driven
+ * through scripted browse and display sequences.  For each sequence
+ * it reports frames/sec, per-frame latency percentiles and what was
+ * allocated along the way.  Build with psbench.pro; run as
+ *
+ *   psbench [covers] [cover WxH] [screen WxH] [zoom]
+ *   psbench 200 130x175 320x240 100
+ *
+ * Covers are all loaded before anything is timed, so the numbers
+ * are the renderer's alone.
+ *
+ * It also checks the renderer against golden images: a fixed set of
+ * browse states (focus, direction, how far into the transition) at a
+ * few resolutions, each compared to a stored PNG and timed against a
+ * stored baseline.  Where there's no PNG, the frame has to match a
+ * checksum from sums.txt exactly instead; that manifest is small
+ * enough to keep in the tree (golden/, generated from a known-good
+ * build, PIXEL_BITS 32; psbench16's in golden/rgb565).  Resting
+ * states are also arrived at the way a user would (from a neighbour,
+ * prerendered while idle, with quality dropping in flight), and that
+ * has to match the full redraw exactly, references or not.  Exits 2
+ * if anything differs or got slower than allowed, 3 if all that's
+ * wrong is references missing.  --update (re)writes the PNGs,
+ * checksums and baselines, unless the build disagrees with itself.
+ *
+ *   psbench --golden <dir> [--update] [--tolerance N] [--slack PCT]
+ *   psbench --golden golden --update
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <QApplication>
+#include <QMouseEvent>
+#include <QDir>
+#include <QMap>
+#include <QtAlgorithms>
+
+#include "ps.hh"
+#include "logger.hh"
+#include "timing.hh"
+#include "pixops.hh"
+#include "album.hh"
+
+
+/*
+ * Count every allocation (QImage data comes straight from malloc, so
+ * hooking operator new alone would miss most of it).  glibc only.
+ */
+
+extern "C" {
+    void *__libc_malloc(size_t);
+    void *__libc_calloc(size_t, size_t);
+    void *__libc_realloc(void *, size_t);
+
+    static uint64_t alloc_bytes = 0;
+    static uint64_t alloc_count = 0;
+
+    static inline void counted(size_t n) {
+        __sync_fetch_and_add(&alloc_bytes, (uint64_t)n);
+        __sync_fetch_and_add(&alloc_count, (uint64_t)1);
+    }
+
+    void *malloc(size_t n) {
+        counted(n);
+        return __libc_malloc(n);
+    }
+
+    void *calloc(size_t n, size_t s) {
+        counted(n * s);
+        return __libc_calloc(n, s);
+    }
+
+    void *realloc(void *p, size_t n) {
+        counted(n);
+        return __libc_realloc(p, n);
+    }
+}
+
+/*
+ * Just enough access to drive the browser by hand: a step is what
+ * the animate and render timers would have done for one frame, a
+ * draw just the render.
+ */
+
+class BenchBrowser : public AlbumBrowser {
+
+ public:
+
+    BenchBrowser(void) {
+        setFixedStep(tick_usec);
+
+        /*
+         * FB_OUTPUT builds can render into a stand-in framebuffer
+         * (e.g. PS_FB=memfd:1280x720) to exercise that path.
+         */
+
+        if (const char *fb = getenv("PS_FB"))
+            setFramebuffer(fb);
+    }
+
+    void step(void) {
+        if (animating())
+            animate();
+        render();
+        takeDirty();
+    }
+
+    void draw(void) {
+        render();
+        takeDirty();
+    }
+
+    /*
+     * What a render thread would get done between input (headless
+     * builds have none): prerendering the neighbouring frames.
+     */
+
+    void idle(void) {
+        while (idleSlice())
+            ;
+    }
+
+    void click(int x) {
+        QMouseEvent e(QEvent::MouseButtonPress, QPoint(x, size().height()/2),
+                      Qt::LeftButton, Qt::LeftButton, Qt::NoModifier);
+        mousePressEvent(&e);
+    }
+
+    void left(void)   { click(0); }
+    void right(void)  { click(size().width()-1); }
+    void center(void) { click(size().width()/2); }
+};
+
+/*
+ * One scripted sequence's worth of measurements.
+ */
+
+typedef struct {
+    const char *name;
+    QVector<uint32_t> usec;
+    uint64_t bytes, allocs;
+    uint64_t start;
+} run_t;
+
+static void begin(run_t &r, const char *name) {
+    r.name   = name;
+    r.usec.clear();
+    r.bytes  = alloc_bytes;
+    r.allocs = alloc_count;
+    r.start  = CTimings::now();
+}
+
+static void frame(BenchBrowser &ab, run_t &r) {
+    uint64_t t0 = CTimings::now();
+    ab.step();
+    r.usec.push_back(CTimings::now() - t0);
+}
+
+static void settle(BenchBrowser &ab, run_t &r) {
+    for (int n = 0; ab.animating() && n < 100000; n++)
+        frame(ab, r);
+}
+
+static void report(run_t &r) {
+    double secs   = (CTimings::now() - r.start) / 1e6;
+    uint64_t bytes  = alloc_bytes - r.bytes;
+    uint64_t allocs = alloc_count - r.allocs;
+    uint32_t n    = r.usec.size();
+
+    if (!n) {
+        printf("%-8s no frames\n", r.name);
+        return;
+    }
+
+    qSort(r.usec.begin(), r.usec.end());
+
+    printf("%-8s %6u frames %8.1f fps   p50 %6.3f  p95 %6.3f  p99 %6.3f  max %6.3f ms   "
+           "%8.1f KB/frame (%.1f allocs)\n",
+           r.name, n, n / secs,
+           r.usec[(n-1) * 50 / 100] / 1000.0, r.usec[(n-1) * 95 / 100] / 1000.0,
+           r.usec[(n-1) * 99 / 100] / 1000.0, r.usec[n-1] / 1000.0,
+           bytes / 1024.0 / n, (double)allocs / n);
+}
+
+/*
+ * Something with detail in both directions, different per cover.
+ */
+
+static QImage synthetic(int i, int w, int h) {
+    QImage image(w, h, QImage::Format_RGB32);
+
+    for (int y = 0; y < h; y++) {
+        QRgb *px = (QRgb *)image.scanLine(y);
+
+        for (int x = 0; x < w; x++)
+            px[x] = qRgb((x * 255 / w + i * 37) & 0xff,
+                         (y * 255 / h + i * 91) & 0xff,
+                         ((x ^ y) * 4 + i) & 0xff);
+    }
+
+    return image;
+}
+
+static bool parseSize(const char *arg, QSize &s) {
+    int w, h;
+
+    if (sscanf(arg, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0)
+        return false;
+
+    s = QSize(w, h);
+    return true;
+}
+
+/* ---------- */
+
+/*
+ * Golden states: fixed covers, so the images only change when the
+ * renderer does.  Cover size follows screen height.
+ */
+
+static const int golden_covers = 24;
+static const int golden_runs   = 15;
+
+typedef struct {
+    int16_t w, h;
+} screen_t;
+
+typedef struct {
+    int8_t   focus;             // offset from the middle cover; -99 = first, 99 = last
+    int8_t   direction;
+    uint16_t tick;
+} state_t;
+
+/*
+ * 480x250 gives 135 wide covers: an odd width, so padded scanlines
+ * in 16-bit builds (PIXEL_BITS) get exercised.
+ */
+
+static const screen_t golden_screens[] = {
+    { 320, 240 }, { 480, 250 }, { 800, 400 }, { 1280, 720 },
+};
+
+static const state_t golden_states[] = {
+    {   0,  0,     0 },
+    {   0,  1, 16384 },
+    {   0,  1, 32768 },
+    {   0,  1, 49152 },
+    {   0, -1, 32768 },
+    {   3, -1,  8192 },
+    { -99,  0,     0 },
+    {  99,  0,     0 },
+};
+
+#define ELEMENTS(a) (sizeof(a) / sizeof(a[0]))
+
+/*
+ * Per-pixel: how many differ by more than tolerance in any channel,
+ * and the largest difference seen.
+ */
+
+static uint32_t compare(const QImage &a, const QImage &b, int tolerance, int &worst) {
+    worst = 0;
+
+    if (a.size() != b.size())
+        return a.width() * a.height();
+
+    uint32_t bad = 0;
+
+    for (int y = 0; y < a.height(); y++) {
+        const QRgb *pa = (const QRgb *)a.scanLine(y);
+        const QRgb *pb = (const QRgb *)b.scanLine(y);
+
+        for (int x = 0; x < a.width(); x++) {
+            int d = qMax(qMax(qAbs(qRed(pa[x])   - qRed(pb[x])),
+                              qAbs(qGreen(pa[x]) - qGreen(pb[x]))),
+                         qAbs(qBlue(pa[x]) - qBlue(pb[x])));
+
+            worst = qMax(worst, d);
+            bad  += (d > tolerance);
+        }
+    }
+
+    return bad;
+}
+
+/*
+ * FNV-1a over the pixels (not the padding) of an RGB32 image.
+ */
+
+static QString checksum(const QImage &image) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (int y = 0; y < image.height(); y++) {
+        const uchar *p = image.scanLine(y);
+
+        for (int i = 0; i < image.width() * 4; i++)
+            h = (h ^ p[i]) * 0x100000001b3ULL;
+    }
+
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)h);
+
+    return QString(hex);
+}
+
+static QMap<QString, QString> loadSums(const QString &path) {
+    QMap<QString, QString> sums;
+    char name[128], sum[17];
+
+    if (FILE *f = fopen(path.toLocal8Bit().data(), "r")) {
+        while (fscanf(f, "%127s %16s", name, sum) == 2)
+            sums[name] = sum;
+        fclose(f);
+    }
+
+    return sums;
+}
+
+static bool saveSums(const QString &path, const QMap<QString, QString> &sums) {
+    FILE *f = fopen(path.toLocal8Bit().data(), "w");
+
+    if (!f)
+        return false;
+
+    foreach (QString name, sums.keys())
+        fprintf(f, "%s %s\n", name.toAscii().data(), sums.value(name).toAscii().data());
+
+    return fclose(f) == 0;
+}
+
+static QMap<QString, uint32_t> loadTimes(const QString &path) {
+    QMap<QString, uint32_t> times;
+    char name[128];
+    unsigned usec;
+
+    if (FILE *f = fopen(path.toLocal8Bit().data(), "r")) {
+        while (fscanf(f, "%127s %u", name, &usec) == 2)
+            times[name] = usec;
+        fclose(f);
+    }
+
+    return times;
+}
+
+static bool saveTimes(const QString &path, const QMap<QString, uint32_t> &times) {
+    FILE *f = fopen(path.toLocal8Bit().data(), "w");
+
+    if (!f)
+        return false;
+
+    foreach (QString name, times.keys())
+        fprintf(f, "%s %u\n", name.toAscii().data(), times.value(name));
+
+    return fclose(f) == 0;
+}
+
+static int golden(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s --golden <dir> [--update] [--tolerance N] [--slack PCT]\n", argv[0]);
+        return 1;
+    }
+
+    QDir dir(argv[2]);
+    bool update   = false;
+    int tolerance = 0;
+    int slack     = 25;
+
+    for (int i = 3; i < argc; i++) {
+        if (!strcmp(argv[i], "--update"))
+            update = true;
+        else if (!strcmp(argv[i], "--tolerance") && i+1 < argc)
+            tolerance = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--slack") && i+1 < argc)
+            slack = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (update && !dir.exists() && !QDir().mkpath(dir.path())) {
+        fprintf(stderr, "unable to create %s\n", argv[2]);
+        return 1;
+    }
+
+    QString timefile = dir.filePath("times.txt");
+    QMap<QString, uint32_t> times = loadTimes(timefile);
+
+    QString sumfile = dir.filePath("sums.txt");
+    QMap<QString, QString> sums = loadSums(sumfile);
+
+    BenchBrowser ab;
+    ab.setCacheBudget(64 << 20);
+    ab.setAdaptiveQuality(false);
+
+    for (int i = 0; i < golden_covers; i++)
+        ab.addCover(synthetic(i, 130, 175), QString("golden-%1").arg(i));
+
+    int failed = 0, missing = 0;
+
+    for (uint32_t s = 0; s < ELEMENTS(golden_screens); s++) {
+        const screen_t &sc = golden_screens[s];
+
+        ab.setCoverSize(QSize(130 * sc.h / 240, 175 * sc.h / 240));
+        ab.resize(QSize(sc.w, sc.h));
+        ab.waitForCovers(0, golden_covers - 1);
+
+        for (uint32_t c = 0; c < ELEMENTS(golden_states); c++) {
+            const state_t &st = golden_states[c];
+
+            int32_t focus = (st.focus == -99) ? 0 :
+                            (st.focus ==  99) ? golden_covers - 1 :
+                            golden_covers / 2 + st.focus;
+
+            QString name = QString("%1x%2-f%3-d%4-t%5").arg(sc.w).arg(sc.h)
+                           .arg(focus).arg(st.direction).arg(st.tick);
+
+            /*
+             * Same state every run, fully redrawn as it stands (no
+             * animation step first); keep the median.
+             */
+
+            QVector<uint32_t> usec;
+
+            for (int r = 0; r < golden_runs; r++) {
+                ab.setBrowseState(focus, st.direction, st.tick);
+
+                uint64_t t0 = CTimings::now();
+                ab.draw();
+                usec.push_back(CTimings::now() - t0);
+            }
+
+            qSort(usec.begin(), usec.end());
+            uint32_t t = usec[golden_runs / 2];
+
+            QString png = dir.filePath(name + ".png");
+            QImage  got = ab.frame().convertToFormat(QImage::Format_RGB32);
+            QString sum = checksum(got);
+
+            /*
+             * Settled states again, through the frame cache, damage
+             * tracking and reduced quality: must be the same frame.
+             */
+
+            if (!st.direction) {
+                int32_t from = focus ? focus - 1 : focus + 1;
+                int worst = 0;
+
+                ab.setAdaptiveQuality(true);
+                ab.setBrowseState(from, 0, 0);
+                ab.draw();
+                ab.idle();
+                if (from < focus)
+                    ab.right();
+                else
+                    ab.left();
+                for (int n = 0; ab.animating() && n < 100000; n++)
+                    ab.step();
+                ab.setAdaptiveQuality(false);
+
+                QImage warm = ab.frame().convertToFormat(QImage::Format_RGB32);
+
+                if (uint32_t bad = compare(warm, got, 0, worst)) {
+                    printf("%-28s FAIL   arriving from %d: %u px differ from a full redraw, max %d\n",
+                           name.toAscii().data(), from, bad, worst);
+
+                    if (update) {
+                        fprintf(stderr, "not updating references from a build that disagrees with itself\n");
+                        return 2;
+                    }
+
+                    failed++;
+                }
+            }
+
+            if (update) {
+                if (!ab.frame().save(png, "PNG")) {
+                    fprintf(stderr, "unable to write %s\n", png.toAscii().data());
+                    return 1;
+                }
+
+                times[name] = t;
+                sums[name]  = sum;
+                printf("%-28s written  %8.3f ms  %s\n", name.toAscii().data(), t / 1000.0,
+                       sum.toAscii().data());
+                continue;
+            }
+
+            /*
+             * Against the PNG if there is one (with the tolerance),
+             * otherwise the checksum.
+             */
+
+            QImage gold(png);
+            int worst = 0;
+            uint32_t bad;
+
+            if (!gold.isNull()) {
+                bad = compare(got, gold.convertToFormat(QImage::Format_RGB32), tolerance, worst);
+            } else if (sums.contains(name)) {
+                bad = (sum != sums.value(name));
+            } else {
+                printf("%-28s MISSING\n", name.toAscii().data());
+                missing++;
+                continue;
+            }
+
+            uint32_t base = times.value(name, 0);
+            bool slow = base && t > base + base * slack / 100;
+
+            printf("%-28s %-6s %8.3f ms (baseline %8.3f)%s",
+                   name.toAscii().data(), bad ? "FAIL" : "ok",
+                   t / 1000.0, base / 1000.0, slow ? " SLOWER" : "");
+
+            if (bad && !gold.isNull())
+                printf("  %u px differ, max %d", bad, worst);
+            else if (bad)
+                printf("  checksum %s, want %s", sum.toAscii().data(),
+                       sums.value(name).toAscii().data());
+            printf("\n");
+
+            failed += (bad || slow);
+        }
+    }
+
+    if (update) {
+        if (!saveTimes(timefile, times)) {
+            fprintf(stderr, "unable to write %s\n", timefile.toAscii().data());
+            return 1;
+        }
+        if (!saveSums(sumfile, sums)) {
+            fprintf(stderr, "unable to write %s\n", sumfile.toAscii().data());
+            return 1;
+        }
+        return 0;
+    }
+
+    printf("%d failed\n", failed);
+
+    /*
+     * Nothing to compare against isn't a pass, but it isn't a
+     * regression either.
+     */
+
+    if (missing)
+        printf("%d missing: no PNG or checksum in %s (--update from a known-good build)\n",
+               missing, argv[2]);
+
+    return failed ? 2 : missing ? 3 : 0;
+}
+
+/* ---------- */
+
+int main(int argc, char **argv) {
+    QApplication app(argc, argv, QApplication::Tty);
+
+    LOG.program("psbench");
+    LOG.level(LOG_WARN);
+
+    if (argc > 1 && !strcmp(argv[1], "--golden"))
+        return golden(argc, argv);
+
+    int covers = 200;
+    QSize cover(130, 175), screen(320, 240);
+    int zoom = 100;
+
+    if ((argc > 1 && (covers = atoi(argv[1])) <= 0) ||
+        (argc > 2 && !parseSize(argv[2], cover)) ||
+        (argc > 3 && !parseSize(argv[3], screen)) ||
+        (argc > 4 && (zoom = atoi(argv[4])) <= 0)) {
+        fprintf(stderr, "usage: %s [covers] [cover WxH] [screen WxH] [zoom]\n", argv[0]);
+        return 1;
+    }
+
+    /*
+     * Set up as init() would, minus the pics dir, splash and cover
+     * cache, and with room for every cover.
+     */
+
+    BenchBrowser ab;
+
+    ab.setCacheBudget(qMin((uint64_t)covers * cover.width() * cover.height() * 12 + (1 << 20),
+                           (uint64_t)0x7fffffff));
+
+    for (int i = 0; i < covers; i++)
+        ab.addCover(synthetic(i, cover.width(), cover.height()),
+                    QString("synthetic-%1").arg(i));
+
+    ab.setCoverSize(cover);
+    ab.setZoom(zoom);
+    ab.resize(screen);
+    ab.waitForCovers(0, covers - 1);
+
+    printf("%d covers @ %dx%d, screen %dx%d, zoom %d, %s pixops\n",
+           covers, cover.width(), cover.height(), screen.width(), screen.height(),
+           zoom, pixopsKernel());
+
+    run_t r;
+
+    /*
+     * One cover at a time, each transition run to a stop.
+     */
+
+    begin(r, "step");
+    for (int i = 0; i < 10; i++) {
+        ab.right();
+        settle(ab, r);
+    }
+    for (int i = 0; i < 10; i++) {
+        ab.left();
+        settle(ab, r);
+    }
+    report(r);
+
+    /*
+     * The same with idle time between clicks, so each transition ends
+     * on a prerendered frame.  (Idle time counts towards fps, not the
+     * frame times.)
+     */
+
+    begin(r, "idle");
+    for (int i = 0; i < 10; i++) {
+        ab.idle();
+        ab.right();
+        settle(ab, r);
+    }
+    for (int i = 0; i < 10; i++) {
+        ab.idle();
+        ab.left();
+        settle(ab, r);
+    }
+    report(r);
+
+    /*
+     * Flicking: a click every few frames, so transitions chain.
+     */
+
+    begin(r, "sweep");
+    for (int i = 0; i < 30; i++) {
+        ab.right();
+        for (int f = 0; f < 3; f++)
+            frame(ab, r);
+    }
+    settle(ab, r);
+    for (int i = 0; i < 30; i++) {
+        ab.left();
+        for (int f = 0; f < 3; f++)
+            frame(ab, r);
+    }
+    settle(ab, r);
+    report(r);
+
+    /*
+     * Into display mode and back out.
+     */
+
+    begin(r, "display");
+    for (int i = 0; i < 5; i++) {
+        ab.center();
+        settle(ab, r);
+        ab.center();
+        frame(ab, r);
+    }
+    report(r);
+
+    return 0;
+}
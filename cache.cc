@@ -0,0 +1,347 @@
+/*
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <QMutexLocker>
+
+#include "ps.hh"
+#include "logger.hh"
+#include "album.hh"
+#include "cache.hh"
+#include "pixops.hh"
+
+
+static const uint32_t CACHE_MAGIC   = 0x43435350;       // "PSCC"
+static const uint32_t CACHE_VERSION = 1;
+static const uint32_t RECORD_MAGIC  = 0x52435350;       // "PSCR"
+
+/*
+ * Record flags: covers are stored however this build lays them out
+ * (see COLUMN_MAJOR) and in its pixel format (PIXEL_BITS), with their
+ * mip chain behind them, and only records with matching flags are
+ * used.
+ */
+
+static const uint32_t RECORD_COLUMNS = 1;
+static const uint32_t RECORD_MIPS    = 2;
+static const uint32_t RECORD_RGB565  = 4;
+static const uint32_t RECORD_FLAGS   = (COLUMN_MAJOR ? RECORD_COLUMNS : 0) | RECORD_MIPS |
+                                       (PIXEL_BITS == 16 ? RECORD_RGB565 : 0);
+
+/*
+ * Records start on page boundaries (so the mapping hands out aligned
+ * pixels); pixels within a record start on a cache line.
+ */
+
+static const uint32_t PAGE = 4096;
+static const uint32_t LINE = 64;
+
+static inline uint32_t roundup(uint32_t n, uint32_t to) {
+    return (n + to - 1) / to * to;
+}
+
+/* ---------- */
+
+CoverCache::CoverCache(void) {
+    map = NULL;
+    mapsize = 0;
+    c_width = c_height = 0;
+    stale = 0;
+}
+
+CoverCache::~CoverCache(void) {
+    if (map)
+        file.unmap(map);
+}
+
+/*
+ * Open (or create) the cache file and map what's there.
+ */
+
+bool CoverCache::open(const QString &path) {
+    out.setFileName(path);
+    file.setFileName(path);
+
+    if (!out.open(QIODevice::ReadWrite)) {
+        LOG.warn("unable to open cover cache %s", (const char*)path.toAscii());
+        return false;
+    }
+
+    /*
+     * Start over if it isn't one of ours, or is from another version.
+     */
+
+    uint32_t header[PAGE / sizeof(uint32_t)];
+    memset(header, 0, sizeof(header));
+
+    if (out.read((char*)header, PAGE) != PAGE ||
+        header[0] != CACHE_MAGIC || header[1] != CACHE_VERSION) {
+
+        LOG.info("creating cover cache %s", (const char*)path.toAscii());
+
+        memset(header, 0, sizeof(header));
+        header[0] = CACHE_MAGIC;
+        header[1] = CACHE_VERSION;
+
+        out.resize(0);
+        out.seek(0);
+        if (out.write((const char*)header, PAGE) != PAGE) {
+            LOG.warn("unable to write cover cache %s", (const char*)path.toAscii());
+            out.close();
+            return false;
+        }
+        out.flush();
+    }
+
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    mapsize = file.size();
+    map     = file.map(0, mapsize);
+
+    if (!map) {
+        LOG.warn("unable to map cover cache %s", (const char*)path.toAscii());
+        mapsize = 0;
+    }
+
+    scan();
+
+    LOG.info("cover cache %s: %u covers, %u stale",
+             (const char*)path.toAscii(), index.size(), stale);
+
+    return true;
+}
+
+/*
+ * Index the newest record of each path for the current cover size.
+ * The file is ours to read but not to trust: a record that doesn't
+ * fit in itself or in the file (torn by a crash mid-append, or just
+ * corrupt) ends the scan and is cut off, and one claiming the current
+ * size whose pixels aren't laid out the way renderColumn() will walk
+ * them is never handed out.
+ */
+
+void CoverCache::scan(void) {
+    index.clear();
+    stale = 0;
+
+    if (!map)
+        return;
+
+    qint64 offset = PAGE;
+
+    while (offset + (qint64)sizeof(record_t) <= mapsize) {
+        const record_t *r = (const record_t *)(map + offset);
+
+        if (r->magic != RECORD_MAGIC || r->length == 0 || r->length % PAGE ||
+            offset + r->length > mapsize ||
+            (qint64)sizeof(record_t) + r->path_len > r->data || r->data % LINE ||
+            (qint64)r->data + (qint64)r->bpl * r->height > r->length)
+            break;
+
+        if (r->c_width == c_width && r->c_height == c_height && r->flags == RECORD_FLAGS &&
+            fits(r)) {
+            QString path = QString::fromUtf8((const char*)(r + 1), r->path_len);
+
+            if (index.contains(path))
+                stale++;
+            index[path] = r;
+        } else {
+            stale++;
+        }
+
+        offset += r->length;
+    }
+
+    if (offset < mapsize) {
+        LOG.warn("cover cache truncated at %u", (uint32_t)offset);
+
+        QMutexLocker l(&lock);
+        out.resize(offset);
+    }
+}
+
+/*
+ * Whether a record's image is the one AlbumCover::process() makes for
+ * the current cover size: same scanlines, same stride, room for the
+ * whole mip chain.
+ */
+
+bool CoverCache::fits(const record_t *r) const {
+    uint16_t total_height = AlbumCover::rows(c_height);
+    uint8_t  n            = AlbumCover::levels(c_width, c_height);
+
+#if COLUMN_MAJOR
+    uint16_t w = total_height, h = c_width;
+#else
+    uint16_t w = c_width, h = total_height;
+#endif
+
+    return r->width == w && r->height == AlbumCover::lines(w, h, n) &&
+        r->bpl == AlbumCover::stride(w) * sizeof(pixel_t);
+}
+
+bool CoverCache::valid(const record_t *r, const AlbumCover &a) {
+    return r->mtime == a.mtime && r->size == a.size;
+}
+
+/*
+ * Records for another size stay in the file, they just aren't
+ * indexed.
+ */
+
+void CoverCache::setCoverSize(uint16_t c_width_, uint16_t c_height_) {
+    if (c_width == c_width_ && c_height == c_height_)
+        return;
+
+    c_width  = c_width_;
+    c_height = c_height_;
+    scan();
+}
+
+/*
+ * Hand out a cached cover.  The image wraps the mapping, so it must
+ * be let go of before close().
+ */
+
+bool CoverCache::find(const AlbumCover &a, QImage &image) {
+    const record_t *r = index.value(a.path);
+
+    if (!r || !valid(r, a))
+        return false;
+
+    image = QImage((const uchar*)r + r->data, r->width, r->height, r->bpl,
+                   PIXEL_FORMAT);
+
+    return true;
+}
+
+/*
+ * Append a freshly processed cover; safe to call from the loader
+ * thread.  Picked up at next open().
+ */
+
+void CoverCache::append(const AlbumCover &a, const QImage &image,
+                        uint16_t c_width_, uint16_t c_height_) {
+
+    if (image.format() != PIXEL_FORMAT)
+        return;
+
+    QMutexLocker l(&lock);
+
+    if (!out.isOpen())
+        return;
+
+    QByteArray path = a.path.toUtf8();
+    uint32_t bpl    = image.bytesPerLine();
+
+    record_t r;
+    memset(&r, 0, sizeof(r));
+
+    r.magic    = RECORD_MAGIC;
+    r.c_width  = c_width_;
+    r.c_height = c_height_;
+    r.width    = image.width();
+    r.height   = image.height();
+    r.bpl      = bpl;
+    r.flags    = RECORD_FLAGS;
+    r.mtime    = a.mtime;
+    r.size     = a.size;
+    r.path_len = path.size();
+    r.data     = roundup(sizeof(r) + r.path_len, LINE);
+    r.length   = roundup(r.data + bpl * r.height, PAGE);
+
+    qint64 start  = out.size();
+    qint64 pixels = (qint64)bpl * r.height;
+    QByteArray pad(PAGE, 0);
+
+    out.seek(start);
+
+    bool ok =
+        out.write((const char*)&r, sizeof(r)) == (qint64)sizeof(r) &&
+        out.write(path) == path.size() &&
+        out.write(pad.constData(), r.data - sizeof(r) - r.path_len) >= 0 &&
+        out.write((const char*)image.bits(), pixels) == pixels &&
+        out.write(pad.constData(), r.length - r.data - pixels) >= 0;
+
+    if (!ok) {
+        LOG.warn("unable to append to cover cache");
+        out.resize(start);
+    }
+}
+
+/*
+ * Stop appending, and if more than half the file is dead weight
+ * (changed or vanished sources, replaced or other-size records),
+ * rewrite it with only what's still live for the given covers.
+ */
+
+void CoverCache::close(const QList<AlbumCover> &covers) {
+    QMutexLocker l(&lock);
+
+    if (!out.isOpen())
+        return;
+
+    out.close();
+
+    if (map)
+        file.unmap(map);
+
+    mapsize = file.size();
+    map     = file.map(0, mapsize);
+
+    l.unlock();
+    scan();
+
+    QList<const record_t *> live;
+    qint64 bytes = 0;
+
+    foreach (const AlbumCover &a, covers) {
+        const record_t *r = index.value(a.path);
+
+        if (r && valid(r, a)) {
+            live.push_back(r);
+            bytes += r->length;
+        }
+    }
+
+    qint64 dead = mapsize - PAGE - bytes;
+
+    LOG.info("cover cache: %u live covers, %u dead bytes", live.size(), (uint32_t)dead);
+
+    if (map && dead * 2 > mapsize - PAGE) {
+        QString tmp = file.fileName() + ".new";
+        QFile f(tmp);
+
+        bool ok = f.open(QIODevice::WriteOnly | QIODevice::Truncate) &&
+            f.write((const char*)map, PAGE) == PAGE;
+
+        foreach (const record_t *r, live)
+            ok = ok && f.write((const char*)r, r->length) == (qint64)r->length;
+
+        f.close();
+
+        if (ok && ::rename(tmp.toLocal8Bit().data(), file.fileName().toLocal8Bit().data()) == 0) {
+            LOG.info("cover cache compacted to %u bytes", (uint32_t)(PAGE + bytes));
+        } else {
+            LOG.warn("unable to compact cover cache");
+            QFile::remove(tmp);
+        }
+    }
+
+    index.clear();
+
+    if (map)
+        file.unmap(map);
+    map = NULL;
+    mapsize = 0;
+
+    file.close();
+}
+
+uint32_t CoverCache::count(void) const {
+    return index.size();
+}
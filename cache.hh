@@ -0,0 +1,77 @@
+#ifndef PS_CACHE_HH
+#define PS_CACHE_HH
+
+/*
+ * $Id$
+ *
+ * Persistent cache of processed covers (cover + reflection, RGB32),
+ * so a warm boot doesn't redo the decode/scale/reflect of every
+ * cover.
+ *
+ * The file is a page-sized header followed by page-aligned records,
+ * each holding the source path, its mtime and size, the cover size
+ * it was processed for, and the raw pixels.  It's mapped read-only
+ * at startup and covers are handed out as QImages wrapping the
+ * mapped pages (no copy).  New covers are appended as they're
+ * processed; stale records (source changed, other cover size) are
+ * simply never matched, and get compacted away on close() once they
+ * take up more than half the file.
+ */
+
+#include <stdint.h>
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QImage>
+#include <QString>
+
+class AlbumCover;
+
+class CoverCache {
+
+ private:
+
+    typedef struct {
+        uint32_t magic;
+        uint32_t length;                // whole record, page multiple
+        uint16_t c_width, c_height;     // cover size processed for
+        uint16_t width, height;         // image
+        uint32_t bpl;
+        uint32_t flags;                 // layout and pixel format
+        int64_t  mtime, size;           // source file
+        uint32_t path_len;
+        uint32_t data;                  // offset of pixels in record
+    } record_t;
+
+    QFile file, out;
+    uchar *map;
+    qint64 mapsize;
+
+    QHash<QString, const record_t *> index;
+    uint16_t c_width, c_height;
+    uint32_t stale;
+
+    QMutex lock;
+
+    void scan(void);
+    bool fits(const record_t *) const;
+    static bool valid(const record_t *, const AlbumCover &);
+
+ public:
+
+    CoverCache(void);
+    ~CoverCache(void);
+
+    bool open(const QString &);
+    void close(const QList<AlbumCover> &);
+
+    void setCoverSize(uint16_t, uint16_t);
+
+    bool find(const AlbumCover &, QImage &);
+    void append(const AlbumCover &, const QImage &, uint16_t, uint16_t);
+
+    uint32_t count(void) const;
+};
+
+#endif
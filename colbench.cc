@@ -0,0 +1,124 @@
+/*
+ * $Id$
+ *
+ * Stand-alone benchmark for the raycaster's column walk (pixops.cc):
+ * row-major covers drawn straight into a row-major frame, against
+ * column-major covers drawn into a column-major scratch frame and
+ * blocked-transposed out, with a check that both produce the same
+ * pixels.  Not part of the build:
+ *
+ *   g++ -O2 [-mavx2] -pthread -o colbench colbench.cc pixops.cc
+ *   ./colbench [frames] [width] [height]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fpmath.hh"
+#include "pixops.hh"
+
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/*
+ * A frame's worth of projected columns: every screen column hits
+ * some cover column, with a dy sweeping through what a tilted cover
+ * would give.
+ */
+
+struct column_t {
+    int16_t cover, column;
+    int32_t dy;
+};
+
+static void project(column_t *cols, int w, int covers, int cw) {
+    for (int x = 0; x < w; x++) {
+        cols[x].cover  = (x * covers / w) % covers;
+        cols[x].column = (x * 7) % cw;
+        cols[x].dy     = FPreal_ONE/2 + (x * FPreal_ONE) / w;
+    }
+}
+
+int main(int argc, char **argv) {
+    int frames = (argc > 1) ? atoi(argv[1]) : 500;
+    int w      = (argc > 2) ? atoi(argv[2]) : 320;
+    int h      = (argc > 3) ? atoi(argv[3]) : 240;
+    int covers = 8;
+    int cw     = w * 130 / 320;
+    int ch     = h * 175 / 240;
+    int total  = ch + 1 + ch*2/3;
+
+    uint32_t **rows = new uint32_t*[covers];
+    uint32_t **cols = new uint32_t*[covers];
+    uint32_t *ref     = new uint32_t[w * h];
+    uint32_t *out     = new uint32_t[w * h];
+    uint32_t *scratch = new uint32_t[h * w];
+    column_t *proj    = new column_t[w];
+
+    srand(1);
+    for (int c = 0; c < covers; c++) {
+        rows[c] = new uint32_t[cw * total];
+        cols[c] = new uint32_t[total * cw];
+
+        for (int i = 0; i < cw * total; i++)
+            rows[c][i] = 0xff000000 | ((rand() & 0xffff) << 8) | (rand() & 0xff);
+
+        transposeBlocked(cols[c], total, rows[c], cw, cw, total);
+    }
+
+    project(proj, w, covers, cw);
+    memset(ref, 0, w * h * sizeof(uint32_t));
+    memset(out, 0, w * h * sizeof(uint32_t));
+    memset(scratch, 0, w * h * sizeof(uint32_t));
+
+    int16_t top, bottom;
+    double t0 = now();
+
+    for (int f = 0; f < frames; f++)
+        for (int x = 0; x < w; x++)
+            drawColumn(ref + x, w, h,
+                       rows[proj[x].cover] + proj[x].column, cw, total, ch/2,
+                       proj[x].dy, &top, &bottom);
+
+    double t1 = now();
+
+    for (int f = 0; f < frames; f++) {
+        for (int x = 0; x < w; x++)
+            drawColumn(scratch + x*h, 1, h,
+                       cols[proj[x].cover] + proj[x].column*total, 1, total, ch/2,
+                       proj[x].dy, &top, &bottom);
+
+        transposeBlocked(out, w, scratch, h, h, w);
+    }
+
+    double t2 = now();
+
+    if (memcmp(ref, out, w * h * sizeof(uint32_t))) {
+        fprintf(stderr, "MISMATCH: column-major frame differs from row-major\n");
+        return 1;
+    }
+
+    printf("%d frames @ %dx%d (covers %dx%d)\n", frames, w, h, cw, total);
+    printf("  row-major   : %8.2f ms (%7.1f us/frame)\n", (t1-t0)*1e3, (t1-t0)*1e6/frames);
+    printf("  col+transp. : %8.2f ms (%7.1f us/frame)\n", (t2-t1)*1e3, (t2-t1)*1e6/frames);
+    printf("  speedup     : %.2fx\n", (t1-t0)/(t2-t1));
+
+    for (int c = 0; c < covers; c++) {
+        delete[] rows[c];
+        delete[] cols[c];
+    }
+    delete[] rows;
+    delete[] cols;
+    delete[] ref;
+    delete[] out;
+    delete[] scratch;
+    delete[] proj;
+
+    return 0;
+}
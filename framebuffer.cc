@@ -0,0 +1,252 @@
+/*
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/fb.h>
+
+#include "logger.hh"
+#include "framebuffer.hh"
+
+
+CFramebuffer::CFramebuffer(void) {
+    fd      = -1;
+    map     = NULL;
+    mapSize = 0;
+    width   = height = 0;
+    stride  = 0;
+    pages   = page = 0;
+    device  = false;
+}
+
+CFramebuffer::~CFramebuffer(void) {
+    close();
+}
+
+/*
+ * "/dev/fbN", "<file>:WxH[xPAGES]" or "memfd:WxH[xPAGES]".
+ */
+
+bool CFramebuffer::open(const char *spec) {
+    close();
+
+    const char *geometry = strrchr(spec, ':');
+
+    if (geometry) {
+        char path[256];
+        snprintf(path, sizeof(path), "%.*s", (int)(geometry - spec), spec);
+        return openStandIn(path, geometry + 1);
+    }
+
+    return openDevice(spec);
+}
+
+bool CFramebuffer::openDevice(const char *path) {
+    struct fb_var_screeninfo var;
+    struct fb_fix_screeninfo fix;
+
+    if ((fd = ::open(path, O_RDWR)) < 0) {
+        LOG.error("unable to open framebuffer %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    if (ioctl(fd, FBIOGET_VSCREENINFO, &var) < 0) {
+        LOG.error("%s is not a framebuffer", path);
+        close();
+        return false;
+    }
+
+    /*
+     * Has to be what we render (PIXEL_BITS): xRGB8888 or RGB565.
+     */
+
+#if PIXEL_BITS == 16
+    if (var.bits_per_pixel != 16 ||
+        var.red.offset != 11 || var.green.offset != 5 || var.blue.offset != 0) {
+        LOG.error("framebuffer %s is %ubpp, need RGB565", path, var.bits_per_pixel);
+#else
+    if (var.bits_per_pixel != 32 ||
+        var.red.offset != 16 || var.green.offset != 8 || var.blue.offset != 0) {
+        LOG.error("framebuffer %s is %ubpp, need xRGB32", path, var.bits_per_pixel);
+#endif
+        close();
+        return false;
+    }
+
+    /*
+     * Ask for a second page if there isn't one; plenty of drivers say
+     * no, and then we draw on screen.
+     */
+
+    if (var.yres_virtual < 2 * var.yres) {
+        struct fb_var_screeninfo want = var;
+        want.yres_virtual = 2 * var.yres;
+        want.yoffset = 0;
+
+        if (ioctl(fd, FBIOPUT_VSCREENINFO, &want) == 0)
+            ioctl(fd, FBIOGET_VSCREENINFO, &var);
+    }
+
+    ioctl(fd, FBIOGET_FSCREENINFO, &fix);
+
+    width   = var.xres;
+    height  = var.yres;
+    stride  = fix.line_length;
+    pages   = (var.yres_virtual >= 2 * var.yres) ? 2 : 1;
+    mapSize = fix.smem_len;
+    device  = true;
+
+    if ((size_t)stride * height * pages > mapSize)
+        pages = 1;
+
+    map = (uchar *)mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (map == MAP_FAILED) {
+        LOG.error("unable to map framebuffer %s: %s", path, strerror(errno));
+        map = NULL;
+        close();
+        return false;
+    }
+
+    /*
+     * Draw into whichever page isn't showing.
+     */
+
+    page = (pages > 1 && var.yoffset < var.yres) ? 1 : 0;
+
+    LOG.info("framebuffer %s: %ux%u, %u bytes/line, %u page(s)",
+             path, width, height, stride, pages);
+
+    return true;
+}
+
+bool CFramebuffer::openStandIn(const char *path, const char *geometry) {
+    unsigned w = 0, h = 0, n = 2;
+
+    if (sscanf(geometry, "%ux%ux%u", &w, &h, &n) < 2 || !w || !h || n < 1 || n > 2) {
+        LOG.error("bad framebuffer geometry \"%s\", want WxH[xPAGES]", geometry);
+        return false;
+    }
+
+    if (!strcmp(path, "memfd")) {
+#ifdef SYS_memfd_create
+        fd = syscall(SYS_memfd_create, "ps-framebuffer", 0);
+#else
+        errno = ENOSYS;
+#endif
+    } else {
+        fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    }
+
+    if (fd < 0) {
+        LOG.error("unable to open framebuffer %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    width   = w;
+    height  = h;
+    stride  = w * PIXEL_BITS / 8;
+    pages   = n;
+    page    = (n > 1) ? 1 : 0;
+    mapSize = (size_t)stride * height * pages;
+    device  = false;
+
+    if (ftruncate(fd, mapSize) < 0) {
+        LOG.error("unable to size framebuffer %s: %s", path, strerror(errno));
+        close();
+        return false;
+    }
+
+    map = (uchar *)mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (map == MAP_FAILED) {
+        LOG.error("unable to map framebuffer %s: %s", path, strerror(errno));
+        map = NULL;
+        close();
+        return false;
+    }
+
+    LOG.info("framebuffer stand-in %s: %ux%u, %u page(s)", path, width, height, pages);
+
+    return true;
+}
+
+void CFramebuffer::close(void) {
+    if (map)
+        munmap(map, mapSize);
+    if (fd >= 0)
+        ::close(fd);
+
+    fd  = -1;
+    map = NULL;
+}
+
+bool CFramebuffer::isOpen(void) const {
+    return map != NULL;
+}
+
+QSize CFramebuffer::size(void) const {
+    return QSize(width, height);
+}
+
+uint8_t CFramebuffer::pageCount(void) const {
+    return pages;
+}
+
+uchar *CFramebuffer::pageBits(uint8_t p) const {
+    return map + (size_t)p * stride * height;
+}
+
+/*
+ * The top-left s of the back page.  Nothing may keep a (shallow) copy
+ * of it while drawing, or QImage would detach from the mapping.
+ */
+
+QImage CFramebuffer::back(const QSize &s) const {
+    return QImage(pageBits(page), qMin(s.width(), (int)width), qMin(s.height(), (int)height),
+                  stride, PIXEL_FORMAT);
+}
+
+/*
+ * Show the back page, then copy what changed on it over to the page
+ * that becomes the back one, which still has the frame before.
+ */
+
+void CFramebuffer::present(const QRect &dirty) {
+    if (pages < 2)
+        return;
+
+    if (device) {
+        struct fb_var_screeninfo var;
+
+        if (ioctl(fd, FBIOGET_VSCREENINFO, &var) == 0) {
+            var.yoffset = page * height;
+            ioctl(fd, FBIOPAN_DISPLAY, &var);
+        }
+
+#ifdef FBIO_WAITFORVSYNC
+        uint32_t crtc = 0;
+        ioctl(fd, FBIO_WAITFORVSYNC, &crtc);
+#endif
+    }
+
+    QRect r = dirty & QRect(0, 0, width, height);
+    uchar *from = pageBits(page);
+    uchar *to   = pageBits(page ^ 1);
+
+    for (int y = r.top(); y <= r.bottom(); y++) {
+        size_t o = (size_t)y * stride + r.left() * PIXEL_BITS / 8;
+        memcpy(to + o, from + o, r.width() * PIXEL_BITS / 8);
+    }
+
+    page ^= 1;
+}
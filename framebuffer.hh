@@ -0,0 +1,65 @@
+#ifndef PS_FRAMEBUFFER_HH
+#define PS_FRAMEBUFFER_HH
+
+/*
+ * $Id$
+ *
+ * A memory-mapped framebuffer to render straight into (FB_OUTPUT, see
+ * ps.hh): back() wraps the page to draw next as a QImage, present()
+ * shows it.  With two pages (a virtual resolution at least twice the
+ * visible height) present() pans to the new page, and then brings the
+ * other one up to date by copying just what changed, so the renderers
+ * can keep redrawing only what moved.  With one page, drawing is
+ * already on screen.
+ *
+ * Stand-ins for testing on machines without a suitable /dev/fb*: a
+ * spec of "<file>:WxH[xPAGES]" maps a plain file of that geometry
+ * (created or resized as needed), and "memfd:WxH[xPAGES]" an
+ * anonymous one.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <QImage>
+#include <QRect>
+#include <QSize>
+
+#include "ps.hh"
+
+
+class CFramebuffer {
+
+ private:
+    int fd;
+    uchar *map;
+    size_t mapSize;
+
+    uint16_t width, height;
+    uint32_t stride;            // bytes per line
+    uint8_t pages;
+    uint8_t page;               // the back one
+    bool device;                // a real fb: pan to flip
+
+    bool openDevice(const char *);
+    bool openStandIn(const char *, const char *);
+
+    uchar *pageBits(uint8_t) const;
+
+ public:
+
+    CFramebuffer(void);
+    ~CFramebuffer(void);
+
+    bool open(const char *);
+    void close(void);
+    bool isOpen(void) const;
+
+    QSize size(void) const;
+    uint8_t pageCount(void) const;
+
+    QImage back(const QSize &) const;
+    void present(const QRect &);
+};
+
+#endif
@@ -1,7 +1,5 @@
 /*
  * $Id$
- *
- * TODO: add QMutex/QMutexLocker for thread-safety (eventually).
  */
 
 #include <stdio.h>
@@ -11,6 +9,8 @@
 
 //#include <QEvent>
 #include <QKeyEvent>
+#include <QThread>
+#include <QMutexLocker>
 
 #include "logger.hh"
 
@@ -29,17 +29,90 @@ char const *const levels[LOG_ALL] = {
 
 CLogger LOG;
 
+/*
+ * Drains the ring until it's empty, then sleeps until a producer
+ * finds it asleep (or every so often anyway).  It looks once more
+ * after saying it's going to sleep, so a record posted before the
+ * producer could see that isn't left waiting.
+ */
+
+class CLogWriter : public QThread {
+
+ private:
+    CLogger *log;
+
+ protected:
+
+    void run(void) {
+        log->lock.lock();
+
+        while (!log->stopping) {
+            if (!log->drain()) {
+                log->drained.wakeAll();
+                log->sleeping.fetchAndStoreOrdered(1);
+                if (!log->drain())
+                    log->wake.wait(&log->lock, 100);
+                log->sleeping.fetchAndStoreOrdered(0);
+            }
+        }
+
+        log->drain();
+        log->drained.wakeAll();
+        log->lock.unlock();
+    }
+
+ public:
+    CLogWriter(CLogger *log_) : log(log_) {}
+};
+
 
 CLogger::CLogger(void) : QObject() {
-    memset(buf, 0, sizeof(buf));
     progName = NULL;
+    progPID  = 0;
     logLevel = LOG_ALL;
 
+    ring = new record_t[RING];
+    for (uint16_t i = 0; i < RING; i++)
+        ring[i].seq = i;
+    head = 0;
+    lost = 0;
+
+    writer   = NULL;
+    stopping = false;
+    sleeping = 0;
+
+    out      = stdout;
+    outPath  = NULL;
+    outBytes = outMax = 0;
+    outKeep  = 0;
+
     memset(timestamp, 0, sizeof(timestamp));
-    memset(buf, 0, sizeof(buf));
+    stamped = 0;
 }
 
+/*
+ * Whatever is still queued gets written before we go.
+ */
+
 CLogger::~CLogger(void) {
+    if (writer) {
+        lock.lock();
+        stopping = true;
+        wake.wakeAll();
+        lock.unlock();
+
+        writer->wait();
+        delete writer;
+    }
+
+    drain();
+
+    if (out != stdout)
+        fclose(out);
+
+    delete[] ring;
+    delete[] outPath;
+
     if (progName)
         delete[] progName;
 }
@@ -56,6 +129,8 @@ bool CLogger::program(const char *progName_) {
 
     progPID = getpid();
 
+    start();
+
     return true;
 }
 
@@ -71,23 +146,198 @@ const uint8_t CLogger::level(void) const {
     return logLevel;
 }
 
-char const *const CLogger::ts(void) {
-    time_t tt;
-    struct tm *tv;
+/*
+ * Write to path instead of stdout, starting a new file (and keeping
+ * keep old ones as path.1 .. path.keep) every max bytes.
+ */
+
+bool CLogger::file(const char *path, uint32_t max, uint8_t keep) {
+    FILE *f = fopen(path, "a");
+
+    if (!f) {
+        error("unable to open log file %s", path);
+        return false;
+    }
+
+    QMutexLocker l(&lock);
+
+    if (out != stdout)
+        fclose(out);
+
+    delete[] outPath;
+    outPath = new char[strlen(path)+1];
+    strcpy(outPath, path);
+
+    out      = f;
+    outBytes = ftell(f);
+    outMax   = max;
+    outKeep  = keep;
+
+    return true;
+}
+
+void CLogger::rotate(void) {
+    char from[MAXLOGLEN], to[MAXLOGLEN];
+
+    fclose(out);
+
+    for (int i = outKeep; i > 0; i--) {
+        if (i > 1)
+            snprintf(from, sizeof(from), "%s.%i", outPath, i-1);
+        else
+            snprintf(from, sizeof(from), "%s", outPath);
+        snprintf(to, sizeof(to), "%s.%i", outPath, i);
+        rename(from, to);
+    }
+
+    out      = fopen(outPath, outKeep ? "a" : "w");
+    outBytes = 0;
+
+    /*
+     * Back to stdout for good; there's no file left to rotate.
+     */
+
+    if (!out) {
+        out = stdout;
+
+        delete[] outPath;
+        outPath = NULL;
+        outMax  = 0;
+
+        writeLog(LOG_ERROR, time(NULL), "unable to reopen log file, logging to stdout");
+    }
+}
+
+void CLogger::start(void) {
+    QMutexLocker l(&lock);
+
+    if (writer)
+        return;
+
+    writer = new CLogWriter(this);
+    writer->start(QThread::LowPriority);
+}
+
+/*
+ * Wait for everything logged so far to be written.
+ */
+
+void CLogger::flush(void) {
+    QMutexLocker l(&lock);
+
+    if (!writer) {
+        drain();
+        return;
+    }
+
+    while (head != (uint32_t)(int)tail && writer->isRunning()) {
+        wake.wakeOne();
+        drained.wait(&lock, 100);
+    }
+}
+
+uint32_t CLogger::drops(void) const {
+    return lost + (int)dropped;
+}
+
+/*
+ * Formatting the timestamp is only worth doing once a second.
+ */
 
-    tt = time(NULL);
-    tv = localtime(&tt);
+char const *const CLogger::ts(time_t when) {
+    if (when != stamped || !*timestamp) {
+        struct tm tv;
 
-    strftime(timestamp, sizeof(timestamp)-1, "%b %d %H:%M:%S ", tv);
+        localtime_r(&when, &tv);
+        strftime(timestamp, sizeof(timestamp)-1, "%b %d %H:%M:%S ", &tv);
+
+        stamped = when;
+    }
 
     return timestamp;
 }
 
+/*
+ * Claim the next slot (unless the ring is full), format into it and
+ * publish it.
+ */
+
+void CLogger::post(uint8_t level, const char *format, va_list args) {
+    uint32_t pos = (int)tail;
+    record_t *r;
+
+    for (;;) {
+        r = &ring[pos & (RING-1)];
+        int32_t dif = (int32_t)((uint32_t)r->seq.fetchAndAddAcquire(0) - pos);
+
+        if (dif == 0) {
+            if (tail.testAndSetOrdered(pos, pos + 1))
+                break;
+        } else if (dif < 0) {
+            dropped.ref();
+            return;
+        }
+
+        pos = (int)tail;
+    }
+
+    r->level = level;
+    r->when  = time(NULL);
+    vsnprintf(r->text, sizeof(r->text), format, args);
+
+    r->seq.fetchAndStoreRelease(pos + 1);
+
+    /*
+     * Only a sleeping writer needs waking (and only once); otherwise
+     * it'll get to this record without us touching the lock.
+     */
+
+    if (sleeping.testAndSetOrdered(1, 0)) {
+        QMutexLocker l(&lock);
+        wake.wakeOne();
+    }
+}
+
+/*
+ * Writer side: write out everything published, in order.  Returns
+ * whether there was anything.
+ */
+
+bool CLogger::drain(void) {
+    bool any = false;
+
+    for (;;) {
+        record_t *r = &ring[head & (RING-1)];
+
+        if ((uint32_t)r->seq.fetchAndAddAcquire(0) != head + 1)
+            break;
+
+        writeLog(r->level, r->when, r->text);
+
+        r->seq.fetchAndStoreRelease(head + RING);
+        head++;
+        any = true;
+    }
+
+    if (int n = dropped.fetchAndStoreOrdered(0)) {
+        char msg[MAXLEN];
+
+        lost += n;
+        snprintf(msg, sizeof(msg), "log overflow, dropped %i records", n);
+        writeLog(LOG_WARN, time(NULL), msg);
+        any = true;
+    }
+
+    if (any)
+        fflush(out);
+
+    return any;
+}
+
 void CLogger::log(uint8_t level, const char *format, ...) {
     va_list args;
     va_start(args, format);
-    vsnprintf(buf, sizeof(buf)-1, format, args);
-    writeLog(level, buf);
+    post(level, format, args);
     va_end(args);
 }
 
@@ -95,9 +345,7 @@ void CLogger::vlog(uint8_t level, const char *format, va_list args) {
     if (logLevel < level)
         return;
 
-    vsnprintf(buf, sizeof(buf)-1, format, args);
-
-    writeLog(level, buf);
+    post(level, format, args);
 }
 
 void CLogger::puke(const char *format, ...) {
@@ -143,12 +391,19 @@ void CLogger::error(const char *format, ...) {
 }
 
 /*
- * For now, just emit to stdout.  We'll add file support later.
+ * Stdout by default, or the file set with file(); a new file every
+ * outMax bytes.
  */
 
-void CLogger::writeLog(uint8_t level, const char *str) {
-    fprintf(stdout, "%s%s[%i] %s: %s\n",
-            ts(), progName, progPID, levels[level], str);
+void CLogger::writeLog(uint8_t level, time_t when, const char *str) {
+    int n = fprintf(out, "%s%s[%i] %s: %s\n",
+                    ts(when), program(), progPID, levels[level], str);
+
+    if (n > 0)
+        outBytes += n;
+
+    if (outPath && outMax && outBytes >= outMax)
+        rotate();
 }
 
 
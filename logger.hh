@@ -7,9 +7,16 @@
 
 #include <stdint.h>
 #include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
 
 #include <QObject>
 #include <QKeyEvent>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "ps.hh"
 
 
 #define LOG_ALL       9
@@ -24,27 +31,75 @@
 #define LOG_EMERG     0
 
 
+class CLogWriter;
+
+/*
+ * Callers (any thread) only format their message into a slot of a
+ * bounded lock-free ring; a writer thread adds the timestamp and
+ * prefix and does the I/O, to stdout or a rotating file.  If the
+ * ring is full the record is dropped (and counted), never waited
+ * for.
+ */
+
 class CLogger : public QObject {
     Q_OBJECT;
 
+    friend class CLogWriter;
+
  private:
     static const uint8_t  MAXDATELEN = 20;
     static const uint8_t  MAXLEN     = 50;
     static const uint16_t MAXBUFLEN  = 980;
     static const uint16_t MAXLOGLEN  = 1000;
+    static const uint16_t RING       = 128;     // records; power of two
+
+    /*
+     * A slot is free for the producer whose position equals seq, and
+     * ready for the writer once seq is one past that.
+     */
+
+    typedef struct {
+        QAtomicInt seq;
+        uint8_t level;
+        time_t  when;
+        char    text[MAXBUFLEN];
+    } record_t;
+
+    record_t   *ring;
+    QAtomicInt  tail;           // next position to claim (producers)
+    uint32_t    head;           // next position to write (writer)
+    QAtomicInt  dropped;        // since last reported
+    uint32_t    lost;           // reported so far
+
+    /* writer side */
+    CLogWriter *writer;
+    QMutex      lock;
+    QWaitCondition wake, drained;
+    QAtomicInt  sleeping;       // writer is (about to be) waiting on wake
+    bool        stopping;
+
+    FILE       *out;
+    char       *outPath;
+    uint32_t    outBytes, outMax;
+    uint8_t     outKeep;
 
     char timestamp[MAXDATELEN];
-    char buf[MAXBUFLEN];
+    time_t stamped;
 
     char *progName;
     uint16_t progPID;
     uint8_t logLevel;
 
-    char const *const ts(void);
+    char const *const ts(time_t);
 
     void log(uint8_t, const char *, ...);
     void vlog(uint8_t, const char *, va_list);
-    void writeLog(uint8_t, const char *);
+    void post(uint8_t, const char *, va_list);
+    void writeLog(uint8_t, time_t, const char *);
+
+    bool drain(void);
+    void rotate(void);
+    void start(void);
 
  protected:
 
@@ -60,6 +115,11 @@ class CLogger : public QObject {
 
     void level(uint8_t);
     const uint8_t level(void) const;
+    bool wants(uint8_t level_) const { return level_ <= logLevel; }
+
+    bool file(const char *, uint32_t = 1 << 20, uint8_t = 3);
+    void flush(void);
+    uint32_t drops(void) const;
 
     void puke(const char *, ...);
     void debug(const char *, ...);
@@ -75,4 +135,16 @@ class CLogger : public QObject {
 
 extern ::CLogger LOG;
 
+/*
+ * For the chatty levels: compiled out entirely above LOG_COMPILED
+ * (see ps.hh), and otherwise the arguments are only evaluated if the
+ * runtime level lets the message through.
+ */
+
+#define LOG_AT(l, call) \
+    do { if ((l) <= LOG_COMPILED && LOG.wants(l)) LOG.call; } while (0)
+
+#define PS_PUKE(...)  LOG_AT(LOG_PUKE, puke(__VA_ARGS__))
+#define PS_DEBUG(...) LOG_AT(LOG_DEBUG, debug(__VA_ARGS__))
+
 #endif
@@ -3,6 +3,7 @@
  */
 
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <QApplication>
@@ -12,6 +13,42 @@
 #include "album.hh"
 
 
+/*
+ * Byte budgets are given in KB; QCache costs are ints, so 1G is as
+ * far as they go.
+ */
+
+static const long max_kb = 1 << 20;
+
+/*
+ * A budget from the environment, if it's set to a whole number of KB
+ * no less than min (capped at max_kb); anything else is ignored.
+ */
+
+static bool envKB(const char *name, long min, uint32_t &bytes) {
+    const char *s = getenv(name);
+
+    if (!s)
+        return false;
+
+    char *end;
+    long kb = strtol(s, &end, 10);
+
+    if (end == s || *end || kb < min) {
+        LOG.warn("ignoring %s=%s", name, s);
+        return false;
+    }
+
+    if (kb > max_kb) {
+        LOG.warn("%s capped at %li KB", name, max_kb);
+        kb = max_kb;
+    }
+
+    bytes = kb * 1024;
+
+    return true;
+}
+
 int main(int argc, char **argv) {
 
     char const *const arg = "-qws";
@@ -31,11 +68,51 @@ int main(int argc, char **argv) {
     LOG.level(LOG_DEBUG);
     app.installEventFilter(&LOG);
 
+    if (const char *path = getenv("PS_LOG"))
+        LOG.file(path);
+
     /*
      * Initialize the main widget (AlbumBrowser), and show it.
      */
 
     AlbumBrowser ab;
+
+    /*
+     * Cover cache budget can be tuned per device.
+     */
+
+    uint32_t bytes;
+
+    if (envKB("PS_CACHE_KB", 1, bytes))
+        ab.setCacheBudget(bytes);
+
+    /*
+     * Likewise the rendered frame cache (0 turns it off).
+     */
+
+    if (envKB("PS_FRAMES_KB", 0, bytes))
+        ab.setFrameCacheBudget(bytes);
+
+    /*
+     * As is the render thread (RENDER_THREAD builds): QThread priority
+     * 0-6, and a CPU to pin it to.
+     */
+
+    const char *prio = getenv("PS_RENDER_PRIO");
+    const char *cpu  = getenv("PS_RENDER_CPU");
+
+    if (prio || cpu)
+        ab.setRenderThread(prio ? (QThread::Priority)atoi(prio) : QThread::NormalPriority,
+                           cpu ? atoi(cpu) : -1);
+
+    /*
+     * And where the frames go (FB_OUTPUT builds): a /dev/fb*, or a
+     * stand-in (see framebuffer.hh).
+     */
+
+    if (const char *fb = getenv("PS_FB"))
+        ab.setFramebuffer(fb);
+
     if (!ab.init()) {
         LOG.error("unable to initialize album browser, bailing");
         return 1;
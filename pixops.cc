@@ -0,0 +1,421 @@
+/*
+ * $Id$
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "fpmath.hh"
+#include "pixops.hh"
+
+
+/*
+ * x / 100 for x <= 25500 (255 * 100).
+ */
+
+static const uint32_t FADE_MUL   = 5243;
+static const uint32_t FADE_SHIFT = 19;
+
+/*
+ * What the kernels need to know about a pixel format: black, the
+ * fade, and a rounded average of four pixels (2x2 box filter).
+ */
+
+template<typename P> struct Pixel;
+
+template<> struct Pixel<uint32_t> {
+    static const uint32_t BLACK = 0xff000000;
+
+    static inline uint32_t fade(uint32_t p, uint32_t f) {
+        uint32_t r = (((p >> 16) & 0xff) * f * FADE_MUL) >> FADE_SHIFT;
+        uint32_t g = (((p >>  8) & 0xff) * f * FADE_MUL) >> FADE_SHIFT;
+        uint32_t b = (((p      ) & 0xff) * f * FADE_MUL) >> FADE_SHIFT;
+
+        return 0xff000000 | (r << 16) | (g << 8) | b;
+    }
+
+    /*
+     * Red/blue and green are summed in separate lanes (room for four
+     * 8-bit values each), then rounded and divided at once.
+     */
+
+    static inline uint32_t average(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+        uint32_t rb = (a & 0x00ff00ff) + (b & 0x00ff00ff) +
+                      (c & 0x00ff00ff) + (d & 0x00ff00ff) + 0x00020002;
+        uint32_t g  = (a & 0x0000ff00) + (b & 0x0000ff00) +
+                      (c & 0x0000ff00) + (d & 0x0000ff00) + 0x00000200;
+
+        return 0xff000000 | ((rb >> 2) & 0x00ff00ff) | ((g >> 2) & 0x0000ff00);
+    }
+};
+
+template<> struct Pixel<uint16_t> {
+    static const uint16_t BLACK = 0x0000;
+
+    static inline uint16_t fade(uint16_t p, uint32_t f) {
+        uint32_t r = (((p >> 11) & 0x1f) * f * FADE_MUL) >> FADE_SHIFT;
+        uint32_t g = (((p >>  5) & 0x3f) * f * FADE_MUL) >> FADE_SHIFT;
+        uint32_t b = (((p      ) & 0x1f) * f * FADE_MUL) >> FADE_SHIFT;
+
+        return (r << 11) | (g << 5) | b;
+    }
+
+    /*
+     * Same lanes trick in 32 bits: red and blue have the green bits
+     * between them to carry into.
+     */
+
+    static inline uint16_t average(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+        uint32_t rb = (a & 0xf81f) + (b & 0xf81f) + (c & 0xf81f) + (d & 0xf81f) + 0x1002;
+        uint32_t g  = (a & 0x07e0) + (b & 0x07e0) + (c & 0x07e0) + (d & 0x07e0) + 0x0040;
+
+        return ((rb >> 2) & 0xf81f) | ((g >> 2) & 0x07e0);
+    }
+};
+
+static void fadeRun(uint32_t *out, const uint32_t *in, uint32_t n, uint8_t f) {
+    uint32_t i = 0;
+
+#if defined(__AVX2__)
+
+    const __m256i zero  = _mm256_setzero_si256();
+    const __m256i alpha = _mm256_set1_epi32(0xff000000);
+    const __m256i vf    = _mm256_set1_epi16(f);
+    const __m256i vmul  = _mm256_set1_epi16(FADE_MUL);
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i p  = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i lo = _mm256_unpacklo_epi8(p, zero);
+        __m256i hi = _mm256_unpackhi_epi8(p, zero);
+
+        lo = _mm256_srli_epi16(_mm256_mulhi_epu16(_mm256_mullo_epi16(lo, vf), vmul), FADE_SHIFT - 16);
+        hi = _mm256_srli_epi16(_mm256_mulhi_epu16(_mm256_mullo_epi16(hi, vf), vmul), FADE_SHIFT - 16);
+
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_or_si256(_mm256_packus_epi16(lo, hi), alpha));
+    }
+
+#elif defined(__SSE2__)
+
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    const __m128i vf    = _mm_set1_epi16(f);
+    const __m128i vmul  = _mm_set1_epi16(FADE_MUL);
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i p  = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i lo = _mm_unpacklo_epi8(p, zero);
+        __m128i hi = _mm_unpackhi_epi8(p, zero);
+
+        lo = _mm_srli_epi16(_mm_mulhi_epu16(_mm_mullo_epi16(lo, vf), vmul), FADE_SHIFT - 16);
+        hi = _mm_srli_epi16(_mm_mulhi_epu16(_mm_mullo_epi16(hi, vf), vmul), FADE_SHIFT - 16);
+
+        _mm_storeu_si128((__m128i *)(out + i), _mm_or_si128(_mm_packus_epi16(lo, hi), alpha));
+    }
+
+#endif
+
+    for (; i < n; i++)
+        out[i] = Pixel<uint32_t>::fade(in[i], f);
+}
+
+/*
+ * No vector path for 16-bit pixels yet; half the bytes already.
+ */
+
+static void fadeRun(uint16_t *out, const uint16_t *in, uint32_t n, uint8_t f) {
+    for (uint32_t i = 0; i < n; i++)
+        out[i] = Pixel<uint16_t>::fade(in[i], f);
+}
+
+template<typename P>
+void fadeCopy(P *out, const P *in, uint32_t n, uint8_t f) {
+    fadeRun(out, in, n, f);
+}
+
+template<typename P>
+void fadeSpan(P *px, uint32_t n, uint8_t f) {
+    fadeRun(px, px, n, f);
+}
+
+template<typename P>
+void trimSpan(const P *px, int16_t *lo, int16_t *hi) {
+    while (*lo <= *hi && px[*lo] == Pixel<P>::BLACK)
+        (*lo)++;
+
+    while (*hi >= *lo && px[*hi] == Pixel<P>::BLACK)
+        (*hi)--;
+}
+
+template<typename P>
+void reflectCover(P *out, uint32_t out_stride,
+                  const P *in, uint32_t in_stride,
+                  uint16_t width, uint16_t height, uint16_t total_height) {
+
+    for (uint16_t y = 0; y < height; y++)
+        memcpy(out + y*out_stride, in + y*in_stride, width * sizeof(P));
+
+    /*
+     * The gap row between the cover and its reflection.
+     */
+
+    P *px = out + height*out_stride;
+    for (uint16_t x = 0; x < width; x++)
+        px[x] = Pixel<P>::BLACK;
+
+    /*
+     * Row height+1+j mirrors input row height-1-j.
+     */
+
+    for (uint16_t y = height + 1; y < total_height; y++) {
+        uint8_t f = (total_height - y) * 100 / total_height;
+        fadeRun(out + y*out_stride, in + (2*height - y)*in_stride, width, f);
+    }
+}
+
+/*
+ * Where drawColumn() reads from depends only on dy: k rows out from
+ * the middle, the cover row is u(k) = (-dy/2 - k*dy) >> PRECISION
+ * above the first one (and as many below the second); u(0) is 0.
+ * Tables of u(k) * in_step are kept per thread, direct-mapped on
+ * (dy, in_step), and grown as longer columns ask for more.
+ */
+
+typedef struct {
+    int32_t  dy, step;
+    uint32_t n, size;
+    int32_t *off;
+} rowtable_t;
+
+static const uint32_t ROWTABLES = 64;       // power of two
+
+static __thread rowtable_t *rowtables = NULL;
+
+/*
+ * Pool threads come and go (QThreadPool retires idle ones); a thread's
+ * tables go with it.
+ */
+
+static pthread_key_t  rowtables_key;
+static pthread_once_t rowtables_once = PTHREAD_ONCE_INIT;
+
+static void freeRowTables(void *p) {
+    rowtable_t *t = (rowtable_t *)p;
+
+    for (uint32_t i = 0; i < ROWTABLES; i++)
+        free(t[i].off);
+    free(t);
+}
+
+static void rowTablesKey(void) {
+    pthread_key_create(&rowtables_key, freeRowTables);
+}
+
+static inline int32_t rowOffset(int32_t dy, int32_t in_step, uint32_t k) {
+    if (!k)
+        return 0;
+
+    return (int32_t)((-(int64_t)(dy/2) - (int64_t)k * dy) >> FPreal_PRECISION) * in_step;
+}
+
+/*
+ * NULL if there's no memory for the table; the caller works the
+ * offsets out as it goes instead.
+ */
+
+static const int32_t *rowTable(int32_t dy, int32_t in_step, uint32_t n) {
+    if (!rowtables) {
+        rowtable_t *t = (rowtable_t *)calloc(ROWTABLES, sizeof(rowtable_t));
+
+        if (!t)
+            return NULL;
+
+        rowtables = t;
+        pthread_once(&rowtables_once, rowTablesKey);
+        pthread_setspecific(rowtables_key, rowtables);
+    }
+
+    rowtable_t &t = rowtables[((uint32_t)dy * 2654435761u ^ (uint32_t)in_step) & (ROWTABLES-1)];
+
+    if (t.off && t.dy == dy && t.step == in_step && t.n >= n)
+        return t.off;
+
+    if (t.size < n) {
+        uint32_t size = (n > 64) ? n : 64;
+        int32_t *off  = (int32_t *)realloc(t.off, size * sizeof(int32_t));
+
+        if (!off)
+            return NULL;
+
+        t.off  = off;
+        t.size = size;
+    }
+
+    for (uint32_t k = 0; k < n; k++)
+        t.off[k] = rowOffset(dy, in_step, k);
+
+    t.dy   = dy;
+    t.step = in_step;
+    t.n    = n;
+
+    return t.off;
+}
+
+/*
+ * How many rows out from a start row have u(k) >= -rows, i.e. stay
+ * on the cover (with rows more of it beyond the start).
+ */
+
+static inline int32_t rowsWithin(int32_t rows, int32_t dy) {
+    if (rows < 0)
+        return 0;
+    if (dy <= 0)
+        return 0x7fff;
+
+    int64_t num = (int64_t)rows * FPreal_ONE - dy/2;
+
+    return 1 + (num > 0 ? num / dy : 0);
+}
+
+/*
+ * Both spans' lengths are known up front, so each is a plain gather
+ * through the table: a load and a store per pixel.
+ */
+
+template<typename P>
+void drawColumn(P *out, int32_t out_step, int16_t out_h,
+                const P *in, int32_t in_step, int16_t in_h, int16_t in_y,
+                int32_t dy, int16_t *top, int16_t *bottom) {
+
+    int16_t out_y1 = out_h/2;
+    int16_t out_y2 = out_y1 + 1;
+
+    int32_t up   = rowsWithin(in_y, dy);
+    int32_t down = rowsWithin(in_h - in_y - 2, dy);
+
+    if (up > out_y1 + 1)
+        up = out_y1 + 1;
+    if (down > out_h - out_y2)
+        down = out_h - out_y2;
+
+    const int32_t *off = rowTable(dy, in_step, (up > down) ? up : (down ? down : 1));
+
+    P *out_px = out + out_y1*out_step;
+    const P *in_px = in + in_y*in_step;
+
+    if (off) {
+        for (int32_t k = 0; k < up; k++, out_px -= out_step)
+            *out_px = in_px[off[k]];
+    } else {
+        for (int32_t k = 0; k < up; k++, out_px -= out_step)
+            *out_px = in_px[rowOffset(dy, in_step, k)];
+    }
+
+    out_px = out + out_y2*out_step;
+    in_px += in_step;
+
+    if (off) {
+        for (int32_t k = 0; k < down; k++, out_px += out_step)
+            *out_px = in_px[-off[k]];
+    } else {
+        for (int32_t k = 0; k < down; k++, out_px += out_step)
+            *out_px = in_px[-rowOffset(dy, in_step, k)];
+    }
+
+    *top    = out_y1 - up + 1;
+    *bottom = out_y2 + down - 1;
+}
+
+/*
+ * 16x16 tiles: 1k per side (at 32 bits), well inside L1 on anything
+ * we run on.
+ */
+
+static const int32_t TILE = 16;
+
+template<typename P>
+void transposeBlocked(P *dst, int32_t dst_stride,
+                      const P *src, int32_t src_stride,
+                      int32_t w, int32_t h) {
+
+    for (int32_t ty = 0; ty < h; ty += TILE) {
+        int32_t ey = (ty + TILE < h) ? ty + TILE : h;
+
+        for (int32_t tx = 0; tx < w; tx += TILE) {
+            int32_t ex = (tx + TILE < w) ? tx + TILE : w;
+
+            for (int32_t x = tx; x < ex; x++) {
+                P *d = dst + x*dst_stride;
+                const P *s = src + x;
+
+                for (int32_t y = ty; y < ey; y++)
+                    d[y] = s[y*src_stride];
+            }
+        }
+    }
+}
+
+uint32_t mipOffset(int32_t w, int32_t h, int32_t stride, uint8_t level) {
+    uint32_t offset = 0;
+
+    for (uint8_t l = 0; l < level; l++)
+        offset += (l ? w >> l : stride) * (h >> l);
+
+    return offset;
+}
+
+template<typename P>
+static void halveImage(P *out, int32_t out_w, int32_t out_h,
+                       const P *in, int32_t in_stride) {
+
+    for (int32_t y = 0; y < out_h; y++) {
+        const P *r0 = in + 2*y*in_stride;
+        const P *r1 = r0 + in_stride;
+
+        for (int32_t x = 0; x < out_w; x++)
+            out[x] = Pixel<P>::average(r0[2*x], r0[2*x+1], r1[2*x], r1[2*x+1]);
+
+        out += out_w;
+    }
+}
+
+template<typename P>
+void buildMips(P *base, int32_t w, int32_t h, int32_t stride, uint8_t levels) {
+    for (uint8_t l = 1; l <= levels; l++)
+        halveImage(base + mipOffset(w, h, stride, l), w >> l, h >> l,
+                   base + mipOffset(w, h, stride, l-1), (l > 1) ? w >> (l-1) : stride);
+}
+
+const char *pixopsKernel(void) {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+/*
+ * The pixel formats we build for (see pixops.hh).
+ */
+
+#define PIXOPS_INSTANTIATE(P) \
+    template void fadeSpan<P>(P *, uint32_t, uint8_t); \
+    template void fadeCopy<P>(P *, const P *, uint32_t, uint8_t); \
+    template void trimSpan<P>(const P *, int16_t *, int16_t *); \
+    template void reflectCover<P>(P *, uint32_t, const P *, uint32_t, \
+                                  uint16_t, uint16_t, uint16_t); \
+    template void drawColumn<P>(P *, int32_t, int16_t, const P *, int32_t, int16_t, int16_t, \
+                                int32_t, int16_t *, int16_t *); \
+    template void transposeBlocked<P>(P *, int32_t, const P *, int32_t, int32_t, int32_t); \
+    template void buildMips<P>(P *, int32_t, int32_t, int32_t, uint8_t);
+
+PIXOPS_INSTANTIATE(uint32_t)
+PIXOPS_INSTANTIATE(uint16_t)
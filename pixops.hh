@@ -0,0 +1,111 @@
+#ifndef PS_PIXOPS_HH
+#define PS_PIXOPS_HH
+
+/*
+ * $Id$
+ *
+ * Raw pixel kernels, for 32-bit (0xffRRGGBB, uint32_t) and 16-bit
+ * (RGB565, uint16_t) images; pixel_t is the one PIXEL_BITS (ps.hh)
+ * builds for.  Deliberately Qt-free, so they can be exercised on
+ * their own (see reflbench.cc).
+ *
+ * The faux alpha "fade" is c * f / 100 per channel, f in [0, 100].
+ * The divide is done as a multiply by a fixed-point reciprocal
+ * (c*f <= 25500, where (x * 5243) >> 19 == x / 100 exactly), which
+ * lets it vectorize: SSE2 or AVX2 when the compiler targets them,
+ * plain C otherwise.  Results are bit-identical across all three.
+ */
+
+#include <stdint.h>
+
+#include "ps.hh"
+
+#if PIXEL_BITS == 16
+typedef uint16_t pixel_t;
+#else
+typedef uint32_t pixel_t;
+#endif
+
+/*
+ * Fade n pixels in place by f percent; alpha is forced to 0xff.
+ */
+
+template<typename P>
+void fadeSpan(P *px, uint32_t n, uint8_t f);
+
+/*
+ * Fade n pixels from in to out.  out == in is fine (fadeSpan() is
+ * just that); any other overlap is not.
+ */
+
+template<typename P>
+void fadeCopy(P *out, const P *in, uint32_t n, uint8_t f);
+
+/*
+ * Narrow [*lo, *hi] to the pixels in it that aren't black
+ * (0xff000000, or 0 in RGB565); *lo > *hi when none are left.
+ */
+
+template<typename P>
+void trimSpan(const P *px, int16_t *lo, int16_t *hi);
+
+/*
+ * Build a cover + reflection in one pass: rows [0, height) of in are
+ * copied, row height is black, and the remaining rows up to
+ * total_height are in mirrored, faded by (total_height-y)*100 /
+ * total_height.  Strides are in pixels.
+ */
+
+template<typename P>
+void reflectCover(P *out, uint32_t out_stride,
+                  const P *in, uint32_t in_stride,
+                  uint16_t width, uint16_t height, uint16_t total_height);
+
+/*
+ * Draw one raytraced cover column.  out points at the first row of a
+ * screen column of out_h rows, out_step pixels apart; in likewise for
+ * a cover column of in_h rows.  Drawing starts at screen row out_h/2
+ * from cover row in_y and works outwards both ways, moving through
+ * the cover by the fixed-point step dy per screen row.  Returns the
+ * screen rows written in top/bottom.
+ *
+ * The steps make it layout-agnostic: row-major images step by a
+ * scanline, column-major ones by a pixel.
+ */
+
+template<typename P>
+void drawColumn(P *out, int32_t out_step, int16_t out_h,
+                const P *in, int32_t in_step, int16_t in_h, int16_t in_y,
+                int32_t dy, int16_t *top, int16_t *bottom);
+
+/*
+ * Transpose a w x h block: dst[x*dst_stride + y] = src[y*src_stride
+ * + x], in tiles small enough that both sides stay in cache.  Strides
+ * in pixels.
+ */
+
+template<typename P>
+void transposeBlocked(P *dst, int32_t dst_stride,
+                      const P *src, int32_t src_stride,
+                      int32_t w, int32_t h);
+
+/*
+ * Mip chain: levels 1..n of a w x h image (stride pixels per line,
+ * which may be more than w) are packed one after another right
+ * behind it, each with its own width (w >> level) as the stride.
+ * mipOffset() is where a level starts, in pixels from the base;
+ * buildMips() fills levels 1..n in by 2x2 box-filtering the level
+ * above.
+ */
+
+uint32_t mipOffset(int32_t w, int32_t h, int32_t stride, uint8_t level);
+template<typename P>
+void buildMips(P *base, int32_t w, int32_t h, int32_t stride, uint8_t levels);
+
+/*
+ * Name of the kernel compiled in ("avx2", "sse2" or "scalar").
+ */
+
+const char *pixopsKernel(void);
+
+#endif
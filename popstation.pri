@@ -0,0 +1,11 @@
+# $Id$
+######################################################################
+# Everything but main(), shared by ps and psbench.
+######################################################################
+
+CONFIG += warn_on
+DEPENDPATH += .
+INCLUDEPATH += .
+
+HEADERS += album.hh render.hh fpmath.hh logger.hh pixops.hh cache.hh timing.hh trace.hh framebuffer.hh
+SOURCES += album.cc render.cc logger.cc pixops.cc cache.cc timing.cc trace.cc framebuffer.cc
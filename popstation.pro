@@ -3,12 +3,18 @@
 # Automatically generated by qmake (2.01a) Wed Mar 25 10:46:47 2009
 ######################################################################
 
-CONFIG += warn_on
-TEMPLATE = app
-TARGET = ps
-DEPENDPATH += .
-INCLUDEPATH += .
-
-# Input
-HEADERS += album.hh render.hh fpmath.hh logger.hh
-SOURCES += album.cc render.cc main.cc logger.cc
+# ps is the browser, psbench the headless renderer benchmark (and
+# psbench16 the same in RGB565); all live here, so each gets its own
+# Makefile.
+
+TEMPLATE = subdirs
+SUBDIRS = ps psbench psbench16
+
+ps.file = ps.pro
+ps.makefile = Makefile.ps
+
+psbench.file = psbench.pro
+psbench.makefile = Makefile.psbench
+
+psbench16.file = psbench16.pro
+psbench16.makefile = Makefile.psbench16
@@ -1,2 +1,72 @@
 
 #define TEST 1
+
+/*
+ * Most verbose log level built in (LOG_PUKE = 8 .. LOG_EMERG = 0, see
+ * logger.hh); PS_PUKE/PS_DEBUG above it compile to nothing.
+ */
+
+#ifndef LOG_COMPILED
+#define LOG_COMPILED (TEST ? 8 : 6)
+#endif
+
+/*
+ * Set (to 1) by targets that run without a display (see psbench.pro).
+ */
+
+#ifndef HEADLESS
+#define HEADLESS 0
+#endif
+
+/*
+ * Run animate()/render() on a thread of their own (see render.hh);
+ * the GUI thread only queues input and blits finished frames.  Not
+ * for headless builds, which drive the renderer by hand.
+ */
+
+#ifndef RENDER_THREAD
+#define RENDER_THREAD 0
+#endif
+
+/*
+ * Render straight into a memory-mapped framebuffer (PS_FB, see
+ * framebuffer.hh) instead of blitting through Qt.
+ */
+
+#ifndef FB_OUTPUT
+#define FB_OUTPUT 0
+#endif
+
+#if HEADLESS
+#undef RENDER_THREAD
+#define RENDER_THREAD 0
+#endif
+
+/*
+ * Store processed covers column-major and raytrace into a
+ * column-major scratch buffer (transposed into the output afterwards),
+ * so the renderer's column walks are sequential in memory.
+ */
+
+#ifndef COLUMN_MAJOR
+#define COLUMN_MAJOR 0
+#endif
+
+/*
+ * Pixel format of the render buffer and processed covers: 32 for
+ * xRGB8888, 16 for RGB565 panels (half the memory and traffic).
+ */
+
+#ifndef PIXEL_BITS
+#define PIXEL_BITS   32
+#endif
+#define PIXEL_FORMAT (PIXEL_BITS == 16 ? QImage::Format_RGB16 : QImage::Format_RGB32)
+
+/*
+ * Fixed-point policy for the raytracer (see fpmath.hh): fractional
+ * bits, and angle steps per full circle.  10/1024 is the original;
+ * 16/4096 is steadier on displays much wider than 800px.
+ */
+
+#define FP_PRECISION 10
+#define FP_ANGLES    1024
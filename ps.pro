@@ -0,0 +1,13 @@
+# $Id$
+######################################################################
+# The browser itself.
+######################################################################
+
+include(popstation.pri)
+
+TEMPLATE = app
+TARGET = ps
+OBJECTS_DIR = .obj/ps
+MOC_DIR = .moc/ps
+
+SOURCES += main.cc
@@ -0,0 +1,15 @@
+# $Id$
+######################################################################
+# Headless renderer benchmark (see bench.cc); same sources, built
+# with HEADLESS so nothing needs a display.
+######################################################################
+
+include(popstation.pri)
+
+TEMPLATE = app
+TARGET = psbench
+OBJECTS_DIR = .obj/psbench
+MOC_DIR = .moc/psbench
+
+DEFINES += HEADLESS=1
+SOURCES += bench.cc
@@ -0,0 +1,17 @@
+# $Id$
+######################################################################
+# psbench for RGB565 panels (PIXEL_BITS 16).  Its golden states are
+# its own: keep them apart from the 32-bit ones, e.g.
+#
+#   psbench16 --golden golden/rgb565 --update
+######################################################################
+
+include(popstation.pri)
+
+TEMPLATE = app
+TARGET = psbench16
+OBJECTS_DIR = .obj/psbench16
+MOC_DIR = .moc/psbench16
+
+DEFINES += HEADLESS=1 PIXEL_BITS=16
+SOURCES += bench.cc
@@ -0,0 +1,113 @@
+/*
+ * $Id$
+ *
+ * Stand-alone benchmark for the reflection kernel (pixops.cc) against
+ * the original QPainter-mirror + scalar fade loop of
+ * AlbumCover::process(), and a check that both produce the same
+ * pixels.  Not part of the build:
+ *
+ *   g++ -O2 [-mavx2] -pthread -o reflbench reflbench.cc pixops.cc
+ *   ./reflbench [covers] [width] [height]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pixops.hh"
+
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/*
+ * The original: mirrored copy, then a per-pixel fade with divides.
+ */
+
+static void reflectOriginal(uint32_t *out, const uint32_t *in,
+                            uint16_t width, uint16_t height, uint16_t total_height) {
+
+    memcpy(out, in, width * height * sizeof(uint32_t));
+
+    for (uint16_t x = 0; x < width; x++)
+        out[height*width + x] = 0xff000000;
+
+    for (uint16_t y = height + 1; y < total_height; y++)
+        memcpy(out + y*width, in + (2*height - y)*width, width * sizeof(uint32_t));
+
+    uint16_t stop = total_height;
+    uint32_t *px;
+    uint8_t r, g, b, f;
+
+    for (uint16_t y = height; y < stop; y++) {
+        px = out + y*width;
+        f = (stop-y)*100/stop;
+
+        for (uint16_t x = 0; x < width; x++) {
+            r = ((px[x] >> 16) & 0xff) * f / 100;
+            g = ((px[x] >>  8) & 0xff) * f / 100;
+            b = ((px[x]      ) & 0xff) * f / 100;
+            px[x] = 0xff000000 | (r << 16) | (g << 8) | b;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    int covers = (argc > 1) ? atoi(argv[1]) : 2000;
+    int width  = (argc > 2) ? atoi(argv[2]) : 130;
+    int height = (argc > 3) ? atoi(argv[3]) : 175;
+    int total  = height + 1 + height*2/3;
+
+    uint32_t *in  = new uint32_t[width * height];
+    uint32_t *ref = new uint32_t[width * total];
+    uint32_t *out = new uint32_t[width * total];
+
+    srand(1);
+    for (int i = 0; i < width * height; i++)
+        in[i] = 0xff000000 | ((rand() & 0xffff) << 8) | (rand() & 0xff);
+
+    /*
+     * Correctness first.
+     */
+
+    reflectOriginal(ref, in, width, height, total);
+    reflectCover(out, width, in, width, width, height, total);
+
+    if (memcmp(ref, out, width * total * sizeof(uint32_t))) {
+        fprintf(stderr, "MISMATCH: %s kernel differs from original\n", pixopsKernel());
+        return 1;
+    }
+
+    for (uint32_t x = 0; x < 25501; x++)
+        if ((x * 5243) >> 19 != x / 100) {
+            fprintf(stderr, "MISMATCH: reciprocal wrong at %u\n", x);
+            return 1;
+        }
+
+    /*
+     * Then timing.
+     */
+
+    double t0 = now();
+    for (int i = 0; i < covers; i++)
+        reflectOriginal(ref, in, width, height, total);
+    double t1 = now();
+    for (int i = 0; i < covers; i++)
+        reflectCover(out, width, in, width, width, height, total);
+    double t2 = now();
+
+    printf("%d covers @ %dx%d (%d rows)\n", covers, width, height, total);
+    printf("  original: %8.2f ms (%6.2f us/cover)\n", (t1-t0)*1e3, (t1-t0)*1e6/covers);
+    printf("  %-8s: %8.2f ms (%6.2f us/cover)\n", pixopsKernel(), (t2-t1)*1e3, (t2-t1)*1e6/covers);
+    printf("  speedup : %.2fx\n", (t1-t0)/(t2-t1));
+
+    delete[] in;
+    delete[] ref;
+    delete[] out;
+
+    return 0;
+}
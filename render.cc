@@ -3,57 +3,633 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+#include <sched.h>
 
 #include <QWidget>
 #include <QTimer>
 #include <QPainter>
+#include <QKeyEvent>
+#include <QMutexLocker>
 
 #include "logger.hh"
+#include "timing.hh"
 #include "render.hh"
 
 
+#if RENDER_THREAD
+
+/*
+ * Just somewhere for AsyncRender::threadLoop() to run, pinned to a
+ * CPU if asked.
+ */
+
+class RenderThread : public QThread {
+
+ private:
+    AsyncRender *ar;
+
+ protected:
+
+    void run(void) {
+        if (ar->_cpu >= 0) {
+            cpu_set_t set;
+
+            CPU_ZERO(&set);
+            CPU_SET(ar->_cpu, &set);
+
+            if (sched_setaffinity(0, sizeof(set), &set))
+                LOG.warn("unable to pin render thread to cpu %i", ar->_cpu);
+        }
+
+        ar->threadLoop();
+    }
+
+ public:
+    RenderThread(AsyncRender *ar_) : ar(ar_) {}
+};
+
+#endif
+
 /* ---------- */
 
-AsyncRender::AsyncRender(QWidget *parent) : QWidget(parent) {
+AsyncRender::AsyncRender(QWidget *parent) : AsyncRenderBase(parent) {
+#if !HEADLESS
+    /*
+     * paintEvent() covers every pixel it's asked to, so don't have Qt
+     * clear the background first.
+     */
+
+    setAttribute(Qt::WA_OpaquePaintEvent);
+#endif
+
+#if FB_OUTPUT
+    _fb = NULL;
+#endif
+
     _renderTimer.setSingleShot(true);
     _renderTimer.setInterval(0);
-    QObject::connect(&_renderTimer, SIGNAL(timeout()), this, SLOT(render()));
+    QObject::connect(&_renderTimer, SIGNAL(timeout()), this, SLOT(renderFrame()));
 
-    _animateTimer.setInterval(30);
+    _lastTick   = 0;
+    _renderCost = 0;
+    _budget     = tick_usec;
+    _fixedStep  = 0;
+
+    _animateTimer.setInterval(_budget / 1000);
     QObject::connect(&_animateTimer, SIGNAL(timeout()), this, SLOT(animate()));
+
+#if RENDER_THREAD
+    _thread   = NULL;
+    _priority = QThread::NormalPriority;
+    _cpu      = -1;
+
+    _stopping      = false;
+    _renderPending = false;
+    _animate       = false;
+    _idle          = false;
+    _nextTick      = 0;
+
+    QObject::connect(this, SIGNAL(frameReady(const QRect &)), this, SLOT(showFrame(const QRect &)));
+#endif
 }
 
 AsyncRender::~AsyncRender(void) {
+    stopRendering();
+
     _renderTimer.stop();
     _animateTimer.stop();
+
+#if FB_OUTPUT
+    delete _fb;
+#endif
+}
+
+/*
+ * Render into the framebuffer named by spec (see CFramebuffer::open())
+ * from the next newBuffer() on.  Qt no longer paints the widget.
+ */
+
+bool AsyncRender::setFramebuffer(const char *spec) {
+#if FB_OUTPUT
+    CFramebuffer *fb = new CFramebuffer;
+
+    if (!fb->open(spec)) {
+        delete fb;
+        return false;
+    }
+
+    delete _fb;
+    _fb = fb;
+
+#if !HEADLESS
+    setAttribute(Qt::WA_PaintOnScreen);
+    setAttribute(Qt::WA_NoSystemBackground);
+#endif
+
+    return true;
+#else
+    LOG.warn("framebuffer output not built in (FB_OUTPUT), ignoring %s", spec);
+    return false;
+#endif
+}
+
+/*
+ * A buffer for renderers to draw in: the framebuffer's back page if
+ * there is one big enough, otherwise a plain image.
+ */
+
+QImage AsyncRender::newBuffer(const QSize &s) {
+#if FB_OUTPUT
+    if (_fb) {
+        if (_fb->size().width() >= s.width() && _fb->size().height() >= s.height())
+            return _fb->back(s);
+
+        LOG.warn("framebuffer is smaller than %ux%u, not using it", s.width(), s.height());
+
+        delete _fb;
+        _fb = NULL;
+
+#if !HEADLESS
+        setAttribute(Qt::WA_PaintOnScreen, false);
+        setAttribute(Qt::WA_NoSystemBackground, false);
+#endif
+    }
+#endif
+
+    return QImage(s, PIXEL_FORMAT);
+}
+
+#if FB_OUTPUT
+
+/*
+ * Flip, and carry on drawing in the new back page.
+ */
+
+void AsyncRender::present(const QRect &r) {
+    _fb->present(r);
+    buffer = _fb->back(buffer.size());
+}
+
+#endif
+
+/*
+ * Subclasses call this first thing in their destructor: the thread
+ * mustn't call into them once they're gone.
+ */
+
+void AsyncRender::stopRendering(void) {
+#if RENDER_THREAD
+    if (!_thread)
+        return;
+
+    _cmdLock.lock();
+    _stopping = true;
+    _cmdWake.wakeOne();
+    _cmdLock.unlock();
+
+    _thread->wait();
+    delete _thread;
+    _thread = NULL;
+#endif
+}
+
+QMutex *AsyncRender::stateLock(void) {
+#if RENDER_THREAD
+    return &_state;
+#else
+    return NULL;
+#endif
+}
+
+/*
+ * Takes effect when the thread starts (the first show).
+ */
+
+void AsyncRender::setRenderThread(QThread::Priority priority, int cpu) {
+#if RENDER_THREAD
+    _priority = priority;
+    _cpu      = cpu;
+#else
+    Q_UNUSED(priority);
+    Q_UNUSED(cpu);
+#endif
 }
 
 void AsyncRender::doAnimate(bool doit) {
-    LOG.puke("doAnimate(%u)", (char)doit);
-    if (doit)
+    PS_PUKE("doAnimate(%u)", (char)doit);
+#if RENDER_THREAD
+    QMutexLocker l(&_cmdLock);
+
+    if (doit && !_animate)
+        _lastTick = _nextTick = 0;
+    _animate = doit;
+
+    _cmdWake.wakeOne();
+#else
+    if (doit) {
+        if (!_animateTimer.isActive())
+            _lastTick = 0;
         _animateTimer.start();
-    else
+    } else
         _animateTimer.stop();
+#endif
 }
 
 void AsyncRender::doRender(void) {
-    LOG.puke("** doRender");
+    PS_PUKE("** doRender");
+#if RENDER_THREAD
+    QMutexLocker l(&_cmdLock);
+
+    _renderPending = true;
+    _cmdWake.wakeOne();
+#else
    _renderTimer.start();
+#endif
+}
+
+/*
+ * Only with a render thread: a slice on the GUI thread would hold up
+ * whatever input arrived during it.
+ */
+
+void AsyncRender::doIdle(void) {
+    PS_PUKE("** doIdle");
+#if RENDER_THREAD
+    QMutexLocker l(&_cmdLock);
+
+    _idle = true;
+    _cmdWake.wakeOne();
+#endif
+}
+
+bool AsyncRender::idleSlice(void) {
+    return false;
 }
 
 bool AsyncRender::animating(void) const {
+#if RENDER_THREAD
+    QMutexLocker l(&_cmdLock);
+    bool b = _animate;
+#else
     bool b = _animateTimer.isActive();
-    LOG.puke("** animating: %u", b);
+#endif
+    PS_PUKE("** animating: %u", b);
     return b;
 }
 
+/*
+ * Time to account for in this animation tick: since the last one, or
+ * a nominal tick for the first (and always _fixedStep, if set).
+ */
+
+uint32_t AsyncRender::elapsed(void) {
+    if (_fixedStep)
+        return _fixedStep;
+
+    uint64_t now = CTimings::now();
+    uint64_t dt  = _lastTick ? now - _lastTick : tick_usec;
+
+    _lastTick = now;
+
+    return qMin(dt, (uint64_t)tick_usec * max_ticks);
+}
+
+/*
+ * Render and keep a running average of what it costs; if that's over
+ * budget, tick less often rather than queue up frames we can't draw.
+ */
+
+void AsyncRender::renderFrame(void) {
+    uint64_t start = CTimings::now();
+
+    render();
+
+    uint32_t cost = CTimings::now() - start;
+
+    _renderCost = _renderCost ? (_renderCost * 7 + cost) / 8 : cost;
+#if !RENDER_THREAD
+    _animateTimer.setInterval(qMax(_budget, _renderCost) / 1000);
+#endif
+}
+
+void AsyncRender::setFrameBudget(uint32_t usec) {
+    _budget = qMax(usec, (uint32_t)1000);
+#if !RENDER_THREAD
+    _animateTimer.setInterval(qMax(_budget, _renderCost) / 1000);
+#endif
+}
+
+uint32_t AsyncRender::frameBudget(void) const {
+    return _budget;
+}
+
+uint32_t AsyncRender::renderCost(void) const {
+    return _renderCost;
+}
+
+/*
+ * Deterministic animation (psbench): every tick is usec long.
+ */
+
+void AsyncRender::setFixedStep(uint32_t usec) {
+    _fixedStep = usec;
+}
+
+#if HEADLESS
+
+/*
+ * Stand-ins for the QWidget side: resizing delivers a resize event
+ * straight away, and updates just accumulate until someone takes them.
+ */
+
+void AsyncRender::resize(const QSize &s) {
+    QResizeEvent e(s, _size.isValid() ? _size : QSize(-1, -1));
+
+    _size = s;
+    resizeEvent(&e);
+}
+
+QSize AsyncRender::size(void) const {
+    return _size;
+}
+
+void AsyncRender::setWindowTitle(const QString &) {
+}
+
+const QImage &AsyncRender::frame(void) const {
+    return buffer;
+}
+
+void AsyncRender::resizeEvent(QResizeEvent *) {
+}
+
+void AsyncRender::mousePressEvent(QMouseEvent *) {
+}
+
+void AsyncRender::keyPressEvent(QKeyEvent *) {
+}
+
+#endif
+
+#if HEADLESS || RENDER_THREAD || FB_OUTPUT
+
+/*
+ * Updates are collected rather than going to the widget: psbench
+ * takes them, or the render thread publishes them with the frame
+ * (see publish()).  Framebuffer output presents them right away
+ * (unless the render thread is doing that).
+ */
+
+void AsyncRender::update(const QRect &r) {
+#if FB_OUTPUT && !RENDER_THREAD
+    if (_fb)
+        present(r);
+#endif
+
+#if HEADLESS || RENDER_THREAD
+    _dirty |= r;
+#elif FB_OUTPUT
+    if (!_fb)
+        QWidget::update(r);
+#endif
+}
+
+#endif
+
+#if HEADLESS || RENDER_THREAD
+
+QRect AsyncRender::takeDirty(void) {
+    QRect r = _dirty;
+    _dirty = QRect();
+    return r;
+}
+
+#endif
+
+#if !HEADLESS
+
+/*
+ * Only blit the damaged part of the buffer (see QWidget::update(QRect)).
+ */
+
 void AsyncRender::paintEvent(QPaintEvent *e) {
-    LOG.puke("** paintEvent");
-    Q_UNUSED(e);
+    PS_PUKE("** paintEvent");
+
+#if FB_OUTPUT
+    if (_fb)
+        return;
+#endif
+
+    StageTimer t(CTimings::S_PAINT);
+
+    QRect r = e->rect();
 
     QPainter p(this);
     p.setRenderHint(QPainter::Antialiasing, false);
-    p.drawImage(QPoint(0, 0), this->buffer);
+#if RENDER_THREAD
+    QMutexLocker l(&_frontLock);
+    p.drawImage(r, _front, r);
+#else
+    p.drawImage(r, this->buffer, r);
+#endif
 }
 
+#endif
+
+#if RENDER_THREAD
+
+/*
+ * GUI thread: input and resizes are only queued for the render
+ * thread (which replays them to the handlers), and the thread is
+ * started the first time we're shown.
+ */
+
+bool AsyncRender::event(QEvent *e) {
+    command_t c;
+
+    switch (e->type()) {
+        case QEvent::MouseButtonPress: {
+            QMouseEvent *me = static_cast<QMouseEvent *>(e);
+            c.type      = e->type();
+            c.pos       = me->pos();
+            c.button    = me->button();
+            c.buttons   = me->buttons();
+            c.modifiers = me->modifiers();
+        } break;
+
+        case QEvent::KeyPress: {
+            QKeyEvent *ke = static_cast<QKeyEvent *>(e);
+            c.type      = e->type();
+            c.key       = ke->key();
+            c.modifiers = ke->modifiers();
+        } break;
+
+        case QEvent::Resize: {
+            QResizeEvent *re = static_cast<QResizeEvent *>(e);
+            c.type    = e->type();
+            c.size    = re->size();
+            c.oldSize = re->oldSize();
+        } break;
+
+        case QEvent::Show: {
+            if (!_thread) {
+                _thread = new RenderThread(this);
+                _thread->start(_priority);
+            }
+        } // fall through
+
+        default:
+            return QWidget::event(e);
+    };
+
+    QMutexLocker l(&_cmdLock);
+    _commands.append(c);
+    _cmdWake.wakeOne();
+
+    return true;
+}
+
+/*
+ * Render thread: replay queued input, tick the animation when it's
+ * due, and render (and publish) when asked to.  _state is held for
+ * all of that; only the queue is shared with the GUI thread.
+ */
+
+void AsyncRender::threadLoop(void) {
+    _cmdLock.lock();
+
+    while (!_stopping) {
+        uint64_t now = CTimings::now();
+        bool tick = _animate && now >= _nextTick;
+
+        if (_commands.isEmpty() && !_renderPending && !tick) {
+
+            /*
+             * Nothing else to do: a slice of idle work, if any.
+             */
+
+            if (_idle) {
+                _idle = false;
+                _cmdLock.unlock();
+
+                _state.lock();
+                bool more = idleSlice();
+                _state.unlock();
+
+                _cmdLock.lock();
+                _idle = _idle || more;
+                continue;
+            }
+
+            if (_animate)
+                _cmdWake.wait(&_cmdLock, (_nextTick - now) / 1000 + 1);
+            else
+                _cmdWake.wait(&_cmdLock);
+            continue;
+        }
+
+        QList<command_t> commands = _commands;
+        _commands.clear();
+
+        if (tick)
+            _nextTick = now + qMax(_budget, _renderCost);
+
+        _cmdLock.unlock();
+        _state.lock();
+
+        for (int i = 0; i < commands.size(); i++)
+            command(commands[i]);
+
+        if (tick && animating())
+            animate();
+
+        _cmdLock.lock();
+        bool pending = _renderPending;
+        _renderPending = false;
+        _cmdLock.unlock();
+
+        if (pending)
+            renderFrame();
+
+        /*
+         * Whatever got drawn goes out, whether by a render we were
+         * asked for or by a command (a resize renders directly).
+         */
+
+        publish();
+
+        _state.unlock();
+        _cmdLock.lock();
+    }
+
+    _cmdLock.unlock();
+}
+
+void AsyncRender::command(const command_t &c) {
+    switch (c.type) {
+        case QEvent::MouseButtonPress: {
+            QMouseEvent e(c.type, c.pos, c.button, c.buttons, c.modifiers);
+            mousePressEvent(&e);
+        } break;
+
+        case QEvent::KeyPress: {
+            QKeyEvent e(c.type, c.key, c.modifiers);
+            keyPressEvent(&e);
+        } break;
+
+        case QEvent::Resize: {
+            QResizeEvent e(c.size, c.oldSize);
+            resizeEvent(&e);
+        } break;
+
+        default:
+            break;
+    };
+}
+
+/*
+ * Copy what changed into the front buffer (the back one keeps its
+ * contents: the renderers only redraw what moved), then have the GUI
+ * thread repaint it.
+ */
+
+void AsyncRender::publish(void) {
+    QRect r = takeDirty() & buffer.rect();
+
+    if (r.isEmpty())
+        return;
+
+#if FB_OUTPUT
+    if (_fb) {
+        present(r);
+        return;
+    }
+#endif
+
+    _frontLock.lock();
+
+    if (_front.size() != buffer.size() || _front.format() != buffer.format()) {
+        _front = buffer.copy();
+        r = buffer.rect();
+    } else {
+        const QImage &back = buffer;
+        uint32_t bpp = back.depth() / 8;
+
+        for (int y = r.top(); y <= r.bottom(); y++)
+            memcpy(_front.scanLine(y) + r.left() * bpp,
+                   back.scanLine(y) + r.left() * bpp, r.width() * bpp);
+    }
+
+    _frontLock.unlock();
+
+    emit frameReady(r);
+}
+
+void AsyncRender::showFrame(const QRect &r) {
+    QWidget::update(r);
+}
+
+#endif
+
 
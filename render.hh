@@ -9,18 +9,114 @@
 
 #include <QWidget>
 #include <QTimer>
+#include <QThread>
+
+#include "ps.hh"
+
+#if FB_OUTPUT
+#include "framebuffer.hh"
+#endif
+
+/*
+ * Headless builds (see psbench.pro) render into buffer just the same,
+ * but there's no window: the few QWidget calls the renderers make are
+ * stood in for below, and updates are only collected.
+ */
+
+#if HEADLESS
+#include <QResizeEvent>
+#include <QMouseEvent>
+#include <QKeyEvent>
+
+typedef QObject AsyncRenderBase;
+#else
+typedef QWidget AsyncRenderBase;
+#endif
+
+/*
+ * With RENDER_THREAD, input and resizes are queued as commands for
+ * the render thread, which replays them to the usual handlers.
+ */
+
+#if RENDER_THREAD
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+
+class RenderThread;
+#endif
 
 /*
  * Generic object for asynchronous animation.
+ *
+ * Animation is paced by the clock rather than by ticks: animate()
+ * asks elapsed() how far to move, so a slow render drops frames
+ * instead of slowing the motion down.  The tick interval follows the
+ * (smoothed) render cost, never going below the frame budget.
  */
 
-class AsyncRender : public QWidget {
+class AsyncRender : public AsyncRenderBase {
     Q_OBJECT;
 
+#if RENDER_THREAD
+    friend class RenderThread;
+#endif
+
  private:
 
     QTimer _animateTimer, _renderTimer;
 
+    uint64_t _lastTick;         // usec; 0 until the first tick
+    uint32_t _renderCost;       // usec, smoothed
+    uint32_t _budget;           // usec per frame we aim for
+    uint32_t _fixedStep;        // usec per tick regardless of clock, or 0
+
+#if HEADLESS
+    QSize _size;
+    QRect _dirty;
+#endif
+
+#if FB_OUTPUT
+    CFramebuffer *_fb;          // NULL unless setFramebuffer() worked
+
+    void present(const QRect &);
+#endif
+
+#if RENDER_THREAD
+    typedef struct {
+        QEvent::Type type;
+        QPoint pos;                     // mouse
+        Qt::MouseButton button;
+        Qt::MouseButtons buttons;
+        Qt::KeyboardModifiers modifiers;
+        int key;                        // key press
+        QSize size, oldSize;            // resize
+    } command_t;
+
+    RenderThread *_thread;
+    QThread::Priority _priority;
+    int _cpu;
+
+    mutable QMutex _cmdLock;            // everything down to _nextTick
+    QWaitCondition _cmdWake;
+    QList<command_t> _commands;
+    bool _stopping;
+    bool _renderPending;
+    bool _animate;
+    bool _idle;
+    uint64_t _nextTick;                 // usec
+
+    QMutex _state;                      // held while the thread works
+
+    QRect _dirty;                       // render thread only
+    QImage _front;
+    QMutex _frontLock;
+
+    void threadLoop(void);
+    void command(const command_t &);
+    void publish(void);
+#endif
+
  protected:
 
     /*
@@ -29,11 +125,52 @@ class AsyncRender : public QWidget {
 
     QImage buffer;
 
+    QImage newBuffer(const QSize &);
+
+    /*
+     * Animation ticks are nominally this long (usec); elapsed() says
+     * how much time to account for in this one, capped at
+     * max_ticks of them.
+     */
+
+    static const uint32_t tick_usec = 30000;
+    static const uint32_t max_ticks = 8;
+
+    uint32_t elapsed(void);
+
     /*
      * QWidget events hooks.
      */
 
+#if HEADLESS
+    virtual void resizeEvent(QResizeEvent *);
+    virtual void mousePressEvent(QMouseEvent *);
+    virtual void keyPressEvent(QKeyEvent *);
+#else
     virtual void paintEvent(QPaintEvent *);
+#endif
+
+#if RENDER_THREAD
+    virtual bool event(QEvent *);
+#endif
+
+    /*
+     * Anything that changes what animate()/render() look at from
+     * outside them (e.g. slots on the GUI thread) holds this; NULL
+     * when there's no render thread (QMutexLocker takes that).
+     */
+
+    QMutex *stateLock(void);
+    void stopRendering(void);
+
+    /*
+     * Background work, a slice at a time, for when there's nothing
+     * else to do (see doIdle()): on the render thread between
+     * commands and frames.  Without one (RENDER_THREAD 0) it isn't
+     * scheduled at all.  Returns whether there's more.
+     */
+
+    virtual bool idleSlice(void);
 
  protected slots:
 
@@ -44,6 +181,18 @@ class AsyncRender : public QWidget {
     virtual void animate(void) = 0;
     virtual void render(void) = 0;
 
+ private slots:
+
+    void renderFrame(void);
+
+#if RENDER_THREAD
+    void showFrame(const QRect &);
+
+ signals:
+
+    void frameReady(const QRect &);
+#endif
+
  public:
 
     AsyncRender(QWidget *parent = 0);
@@ -51,8 +200,32 @@ class AsyncRender : public QWidget {
 
     void doAnimate(bool = true);
     void doRender(void);
+    void doIdle(void);
 
     bool animating(void) const;
+
+    void setFrameBudget(uint32_t);
+    uint32_t frameBudget(void) const;
+    uint32_t renderCost(void) const;
+
+    void setFixedStep(uint32_t);
+    void setRenderThread(QThread::Priority, int = -1);
+    bool setFramebuffer(const char *);
+
+#if HEADLESS
+    void resize(const QSize &);
+    QSize size(void) const;
+#endif
+#if HEADLESS || RENDER_THREAD || FB_OUTPUT
+    void update(const QRect &);
+#endif
+#if HEADLESS || RENDER_THREAD
+    QRect takeDirty(void);
+#endif
+#if HEADLESS
+    void setWindowTitle(const QString &);
+    const QImage &frame(void) const;
+#endif
 };
 
 /* --------- */
@@ -0,0 +1,131 @@
+/*
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+
+#include <QPainter>
+#include <QtAlgorithms>
+
+#include "logger.hh"
+#include "timing.hh"
+#include "trace.hh"
+
+
+CTimings TIMING;
+
+static const char *const stage_names[CTimings::S_MAX] = {
+    "animate",
+    "render",
+    "project",
+    "draw",
+    "paint",
+    "prerender",
+};
+
+
+CTimings::CTimings(void) {
+    memset(samples, 0, sizeof(samples));
+    hud = false;
+}
+
+uint64_t CTimings::now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+void CTimings::record(stage_t s, uint32_t usec) {
+    int h = head[s];
+
+    samples[s][h & (RING-1)] = usec;
+    head[s].fetchAndStoreRelease(h + 1);
+}
+
+const char *CTimings::name(stage_t s) {
+    return stage_names[s];
+}
+
+/*
+ * Percentiles over whatever is in the ring (all of it, once it's
+ * wrapped).
+ */
+
+void CTimings::stats(stage_t s, stats_t &st) const {
+    uint32_t sorted[RING];
+    int h = head[s];
+    uint32_t n = qMin((uint32_t)h, (uint32_t)RING);
+
+    memset(&st, 0, sizeof(st));
+    if (!n)
+        return;
+
+    memcpy(sorted, samples[s], n * sizeof(uint32_t));
+    qSort(sorted, sorted + n);
+
+    st.count = n;
+    st.p50   = sorted[(n-1) * 50 / 100];
+    st.p95   = sorted[(n-1) * 95 / 100];
+    st.p99   = sorted[(n-1) * 99 / 100];
+    st.max   = sorted[n-1];
+}
+
+void CTimings::showHud(bool on) {
+    hud = on;
+}
+
+bool CTimings::showingHud(void) const {
+    return hud;
+}
+
+/*
+ * A line per stage in the top left corner: p50/p95/p99/max, in
+ * milliseconds.  Returns what it drew over.
+ */
+
+QRect CTimings::drawHud(QImage &image) const {
+    QRect r(0, 0, qMin(image.width(), 240), qMin(image.height(), 12 * (S_MAX+1) + 4));
+
+    QPainter p(&image);
+    p.fillRect(r, Qt::black);
+
+    QFont font("Courier");
+    font.setStyleHint(QFont::TypeWriter);
+    font.setPixelSize(10);
+    p.setFont(font);
+    p.setPen(Qt::green);
+
+    p.drawText(4, 12, "stage       p50    p95    p99    max");
+
+    for (int s = 0; s < S_MAX; s++) {
+        stats_t st;
+        char line[64];
+
+        stats((stage_t)s, st);
+        snprintf(line, sizeof(line), "%-9s %6.2f %6.2f %6.2f %6.2f", name((stage_t)s),
+                 st.p50 / 1000.0, st.p95 / 1000.0, st.p99 / 1000.0, st.max / 1000.0);
+
+        p.drawText(4, 12 * (s+2), line);
+    }
+
+    return r;
+}
+
+/* ---------- */
+
+StageTimer::StageTimer(CTimings::stage_t stage_) {
+    stage = stage_;
+    start = CTimings::now();
+}
+
+StageTimer::~StageTimer(void) {
+    if (stage == CTimings::S_MAX)
+        return;
+
+    uint64_t end = CTimings::now();
+
+    TIMING.record(stage, end - start);
+    TRACE.span(CTimings::name(stage), start, end);
+}
@@ -0,0 +1,89 @@
+#ifndef PS_TIMING_HH
+#define PS_TIMING_HH
+
+/*
+ * $Id$
+ *
+ * Per-stage frame timings: each stage drops its duration (monotonic
+ * clock, microseconds) into its own small ring, and the last RING
+ * samples give rolling percentiles.  Recording is a couple of clock
+ * reads and a store, so it's always on; the HUD (drawn into the
+ * frame, toggled with T, see AlbumBrowser::keyPressEvent()) is what
+ * costs.
+ *
+ * One thread records each stage; readers may be on any thread and
+ * only ever see whole samples (the head is published after the
+ * store).
+ */
+
+#include <stdint.h>
+
+#include <QAtomicInt>
+#include <QImage>
+#include <QRect>
+
+
+class CTimings {
+
+ public:
+
+    typedef enum {
+        S_ANIMATE,              // AlbumBrowser::animate()
+        S_RENDER,               // AlbumBrowser::render(), all of it
+        S_PROJECT,              // projectCovers()
+        S_DRAW,                 // strip/column drawing
+        S_PAINT,                // AsyncRender::paintEvent()
+        S_PRERENDER,            // a resting frame, ahead of time
+        S_MAX                   // (to a StageTimer: don't record)
+    } stage_t;
+
+    typedef struct {
+        uint32_t count;
+        uint32_t p50, p95, p99, max;    // usec
+    } stats_t;
+
+ private:
+    static const uint16_t RING = 128;   // power of two
+
+    uint32_t samples[S_MAX][RING];
+    QAtomicInt head[S_MAX];
+
+    bool hud;
+
+ public:
+
+    CTimings(void);
+
+    static uint64_t now(void);
+
+    void record(stage_t, uint32_t);
+    void stats(stage_t, stats_t &) const;
+    static const char *name(stage_t);
+
+    void showHud(bool);
+    bool showingHud(void) const;
+    QRect drawHud(QImage &) const;
+};
+
+/*
+ * Times the enclosing scope as one sample of a stage.
+ */
+
+class StageTimer {
+
+ private:
+    CTimings::stage_t stage;
+    uint64_t start;
+
+ public:
+    StageTimer(CTimings::stage_t);
+    ~StageTimer(void);
+};
+
+/*
+ * Allocated in timing.cc.
+ */
+
+extern ::CTimings TIMING;
+
+#endif
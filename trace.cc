@@ -0,0 +1,174 @@
+/*
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "timing.hh"
+#include "trace.hh"
+
+
+CTrace TRACE;
+
+int CTrace::wake[2] = { -1, -1 };
+
+/*
+ * gettid() is a syscall; only pay for it once per thread.
+ */
+
+static uint32_t threadId(void) {
+    static __thread uint32_t tid = 0;
+
+    if (!tid)
+        tid = syscall(SYS_gettid);
+
+    return tid;
+}
+
+
+CTrace::CTrace(void) {
+    events = NULL;
+    path   = NULL;
+
+    if (const char *p = getenv("PS_TRACE"))
+        start(p);
+}
+
+CTrace::~CTrace(void) {
+    write();
+
+    free(events);
+    delete[] path;
+}
+
+bool CTrace::start(const char *path_) {
+    if (events || !path_ || !*path_)
+        return false;
+
+    events = (event_t *)calloc(MAXEVENTS, sizeof(event_t));
+    if (!events)
+        return false;
+
+    path = new char[strlen(path_)+1];
+    strcpy(path, path_);
+
+    if (pipe(wake) == 0 && pthread_create(&watcher, NULL, watch, NULL) == 0) {
+        pthread_detach(watcher);
+        signal(SIGINT, onSignal);
+        signal(SIGTERM, onSignal);
+    }
+
+    return true;
+}
+
+/*
+ * All that's safe in a handler: tell the watcher which signal it was.
+ */
+
+void CTrace::onSignal(int sig) {
+    int saved = errno;
+    unsigned char s = sig;
+
+    ssize_t n = ::write(wake[1], &s, 1);
+    (void)n;
+
+    errno = saved;
+}
+
+/*
+ * Best effort: whatever is in the buffer goes out, then the signal
+ * gets its default treatment.
+ */
+
+void *CTrace::watch(void *) {
+    unsigned char s;
+    ssize_t n;
+
+    while ((n = read(wake[0], &s, 1)) < 0 && errno == EINTR)
+        ;
+
+    if (n != 1)
+        return NULL;
+
+    TRACE.write();
+
+    signal(s, SIG_DFL);
+    kill(getpid(), s);
+
+    return NULL;
+}
+
+void CTrace::span(const char *name, uint64_t start, uint64_t end, int32_t arg) {
+    if (!events)
+        return;
+
+    uint32_t i = next.fetchAndAddRelaxed(1);
+    if (i >= MAXEVENTS)
+        return;
+
+    event_t &e = events[i];
+    e.start = start;
+    e.dur   = end - start;
+    e.tid   = threadId();
+    e.arg   = arg;
+    e.name  = name;
+}
+
+/*
+ * Complete ("X") events, one per span.  Only the first call writes.
+ */
+
+bool CTrace::write(void) {
+    if (!events || !written.testAndSetOrdered(0, 1))
+        return false;
+
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return false;
+
+    uint32_t n = (uint32_t)(int)next;
+    int pid = getpid();
+
+    fprintf(f, "{\"traceEvents\":[\n");
+
+    bool first = true;
+    for (uint32_t i = 0; i < n && i < MAXEVENTS; i++) {
+        const event_t &e = events[i];
+
+        if (!e.name)
+            continue;
+
+        fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%u,\"pid\":%i,\"tid\":%u",
+                first ? "" : ",\n", e.name, (unsigned long long)e.start, e.dur, pid, e.tid);
+        if (e.arg >= 0)
+            fprintf(f, ",\"args\":{\"i\":%i}", e.arg);
+        fprintf(f, "}");
+
+        first = false;
+    }
+
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":%u}}\n",
+            n > MAXEVENTS ? n - MAXEVENTS : 0);
+    fclose(f);
+
+    return true;
+}
+
+/* ---------- */
+
+TraceSpan::TraceSpan(const char *name_, int32_t arg_) {
+    name  = name_;
+    arg   = arg_;
+    start = TRACE.enabled() ? CTimings::now() : 0;
+}
+
+TraceSpan::~TraceSpan(void) {
+    if (start)
+        TRACE.span(name, start, CTimings::now(), arg);
+}
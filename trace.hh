@@ -0,0 +1,86 @@
+#ifndef PS_TRACE_HH
+#define PS_TRACE_HH
+
+/*
+ * $Id$
+ *
+ * Begin/end spans for the load and frame pipelines, written out as
+ * Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+ *
+ * Off unless PS_TRACE names an output file.  Spans go into a fixed
+ * buffer allocated up front (one atomic add each, from any thread;
+ * once it's full the rest are counted and dropped), and the file is
+ * written at exit, or on SIGINT/SIGTERM.  The signal handler itself
+ * only pokes a pipe (stdio and malloc aren't safe in there); a thread
+ * waiting on the other end writes the file and then lets the signal
+ * take its default course.
+ */
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <QAtomicInt>
+
+
+class CTrace {
+
+ public:
+
+    typedef struct {
+        const char *name;       // static strings only
+        uint64_t start;         // usec, CTimings::now()
+        uint32_t dur;
+        uint32_t tid;
+        int32_t  arg;           // -1 for none
+    } event_t;
+
+ private:
+    static const uint32_t MAXEVENTS = 1 << 18;
+
+    event_t *events;
+    QAtomicInt next;
+    QAtomicInt written;
+
+    char *path;
+
+    static int wake[2];         // the signal handler's pipe
+    pthread_t watcher;
+
+    static void onSignal(int);
+    static void *watch(void *);
+
+ public:
+
+    CTrace(void);
+    ~CTrace(void);
+
+    bool start(const char *);
+    bool enabled(void) const { return events != 0; }
+
+    void span(const char *, uint64_t, uint64_t, int32_t = -1);
+    bool write(void);
+};
+
+/*
+ * Records the enclosing scope as a span, if tracing is on.
+ */
+
+class TraceSpan {
+
+ private:
+    const char *name;
+    int32_t arg;
+    uint64_t start;
+
+ public:
+    TraceSpan(const char *, int32_t = -1);
+    ~TraceSpan(void);
+};
+
+/*
+ * Allocated in trace.cc.
+ */
+
+extern ::CTrace TRACE;
+
+#endif